@@ -0,0 +1,143 @@
+#include <inttypes.h>
+#include <string.h> // strncmp, memcpy
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "asset.h"
+
+// Bundle layout, little endian, written by pack_assets.py:
+//   header  magic "ASET", version, count, total size
+//   entries count * asset_entry_t
+//   data    each asset 4-byte aligned, offsets from the bundle start
+#define ASSET_MAGIC 0x54455341 // "ASET"
+#define ASSET_VERSION 1
+#define ASSET_NAME_LEN 20
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	uint32_t size;
+} asset_header_t;
+
+typedef struct {
+	char     name[ASSET_NAME_LEN]; // NUL padded, not terminated if full
+	uint8_t  type;
+	uint8_t  reserved[3];
+	uint32_t offset;
+	uint32_t size;
+	uint32_t info[2];
+} asset_entry_t;
+
+static const char *TAG = "asset";
+
+static const uint8_t *bundle;
+static const asset_entry_t *entries;
+static int32_t count;
+static esp_partition_mmap_handle_t map_handle;
+
+// Map the asset bundle in a data partition.
+// label: partition label, e.g. "storage".
+// Return zero if successful, or non-zero otherwise.
+int32_t asset_init(const char *label)
+{
+	if (bundle != NULL) asset_deinit();
+
+	const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+	if (part == NULL) {
+		ESP_LOGE(TAG, "partition %s not found", label);
+		return -1;
+	}
+
+	// Check the header before mapping the whole bundle
+	asset_header_t hdr;
+	if (esp_partition_read(part, 0, &hdr, sizeof(hdr)) != ESP_OK) {
+		ESP_LOGE(TAG, "esp_partition_read fail");
+		return -1;
+	}
+	if (hdr.magic != ASSET_MAGIC || hdr.version != ASSET_VERSION) {
+		ESP_LOGE(TAG, "no asset bundle in partition %s", label);
+		return -1;
+	}
+	uint32_t table = sizeof(hdr) + hdr.count*sizeof(asset_entry_t);
+	if (hdr.size > part->size || table > hdr.size) {
+		ESP_LOGE(TAG, "bad bundle size %"PRIu32, hdr.size);
+		return -1;
+	}
+
+	const void *ptr;
+	if (esp_partition_mmap(part, 0, hdr.size, ESP_PARTITION_MMAP_DATA, &ptr, &map_handle) != ESP_OK) {
+		ESP_LOGE(TAG, "esp_partition_mmap fail");
+		return -1;
+	}
+
+	// An entry outside the bundle means a corrupt image, reject all of it
+	const asset_entry_t *e = (const asset_entry_t *)((const uint8_t *)ptr + sizeof(hdr));
+	for (int32_t i = 0; i < hdr.count; i++) {
+		if (e[i].offset < table || e[i].offset > hdr.size || e[i].size > hdr.size - e[i].offset) {
+			ESP_LOGE(TAG, "bad entry %"PRId32, i);
+			esp_partition_munmap(map_handle);
+			return -1;
+		}
+	}
+
+	bundle = ptr;
+	entries = e;
+	count = hdr.count;
+	ESP_LOGI(TAG, "%"PRId32" assets, %"PRIu32" bytes", count, hdr.size);
+	return 0;
+}
+
+// Unmap the bundle.
+void asset_deinit(void)
+{
+	if (bundle == NULL) return;
+	esp_partition_munmap(map_handle);
+	bundle = NULL;
+	entries = NULL;
+	count = 0;
+}
+
+// Return the number of assets in the bundle.
+int32_t asset_count(void)
+{
+	return count;
+}
+
+// Return the ID of the asset with the given name, or -1 if not found.
+// name: asset name as given in the manifest.
+int32_t asset_find(const char *name)
+{
+	if (strnlen(name, ASSET_NAME_LEN+1) > ASSET_NAME_LEN) return -1; // can't match
+	for (int32_t i = 0; i < count; i++) {
+		if (strncmp(entries[i].name, name, ASSET_NAME_LEN) == 0) return i;
+	}
+	return -1;
+}
+
+// Get an asset by ID.
+// id: index from asset_find() or the generated header.
+// asset: filled with a pointer into the mapped bundle.
+bool asset_get(int32_t id, asset_t *asset)
+{
+	if (id < 0 || id >= count) return false;
+	const asset_entry_t *e = &entries[id];
+	asset->data = bundle + e->offset;
+	asset->size = e->size;
+	asset->type = e->type;
+	asset->info[0] = e->info[0];
+	asset->info[1] = e->info[1];
+	return true;
+}
+
+// Return the name of an asset, or NULL if the ID is out of range.
+// Names that fill the entry are not terminated, so they are copied out.
+const char *asset_name(int32_t id)
+{
+	static char name[ASSET_NAME_LEN+1];
+	if (id < 0 || id >= count) return NULL;
+	memcpy(name, entries[id].name, ASSET_NAME_LEN);
+	name[ASSET_NAME_LEN] = '\0';
+	return name;
+}
@@ -0,0 +1,59 @@
+#ifndef ASSET_H_
+#define ASSET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Assets are packed by pack_assets.py into a bundle that is flashed to a
+// data partition. The bundle is memory mapped, so asset data is read in
+// place through the flash cache. Do not use it from an ISR that can run
+// while the cache is disabled (flash writes).
+
+typedef enum {
+	ASSET_RAW,   // bytes as given
+	ASSET_IMAGE, // native RGB565, width*height pixels
+	ASSET_QOI,   // QOI image, see lcdDrawQoi()
+	ASSET_FONT,  // glyph bitmap, as in glcdfont.c
+	ASSET_AUDIO, // unsigned samples, see sound_start()
+} asset_type_t;
+
+typedef struct {
+	const void  *data;
+	uint32_t     size;    // in bytes
+	asset_type_t type;
+	uint32_t     info[2]; // image/QOI: width, height; font: char width, height;
+	                      // audio: sample rate, bits per sample
+} asset_t;
+
+// Map the asset bundle in a data partition. Must be called before the
+// other functions.
+// label: partition label, e.g. "storage".
+// Return zero if successful, or non-zero otherwise.
+int32_t asset_init(const char *label);
+
+// Unmap the bundle. Pointers from asset_get() are no longer valid.
+void asset_deinit(void);
+
+// Return the number of assets in the bundle.
+int32_t asset_count(void);
+
+// Return the ID of the asset with the given name, or -1 if not found.
+// IDs are also written to a header by pack_assets.py --header.
+int32_t asset_find(const char *name);
+
+// Get an asset by ID. The data points into the mapped bundle, no copy.
+// Return false if the ID is out of range.
+bool asset_get(int32_t id, asset_t *asset);
+
+// Return the name of an asset, or NULL if the ID is out of range.
+const char *asset_name(int32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASSET_H_
@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+
+"""
+Pack images, fonts and audio into an asset bundle for a data partition.
+Run by the build (see project_include.cmake) or by hand:
+    pack_assets.py <manifest.csv> <output.bin> [--size N] [--header ids.h]
+
+The manifest has one asset per line, paths relative to the manifest:
+    # Name,  Type,  File,                    Options
+    apple,   image, apple.ppm,               qoi dither
+    ouch,    audio, ouch.wav
+    boom,    audio, ../components/audio/x.c, 48000
+    font,    font,  ../components/lcd/glcdfont.c, 5x8
+
+Types and inputs:
+    raw    any file, copied
+    image  .ppm (P6), .png/.bmp (needs Pillow) or .qoi; options "qoi"
+           compresses, otherwise pixels are stored as native RGB565;
+           "dither" quantizes with the 4x4 ordered dither of
+           lcdConvertRGB888 instead of truncating
+    font   .c byte array or binary file; option is the char size WxH
+    audio  .wav (8 or 16 bit, mono) or .c byte array of 8-bit unsigned
+           samples; option is the sample rate, required for .c files
+The bundle layout must match asset.c.
+"""
+
+import argparse
+import csv
+import os
+import re
+import struct
+import sys
+import wave
+
+MAGIC = b"ASET"
+VERSION = 1
+NAME_LEN = 20
+ALIGN = 4
+TYPES = {"raw": 0, "image": 1, "qoi": 2, "font": 3, "audio": 4}
+# 4x4 ordered dither thresholds, as in components/lcd/gen_tables.py
+BAYER4 = [0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5]
+
+
+def c_array(path):
+    """Bytes of the first array initializer in a C file"""
+    with open(path, encoding="ascii", errors="replace") as f:
+        text = f.read()
+    body = text[text.index("{") + 1:text.index("}")]
+    return bytes(int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body))
+
+
+def read_ppm(path):
+    """Width, height and (r, g, b) pixels of a binary PPM file"""
+    with open(path, "rb") as f:
+        data = f.read()
+    tokens = []
+    pos = 0
+    while len(tokens) < 4:  # magic, width, height, maxval
+        while data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b"#":
+            pos = data.index(b"\n", pos)
+            continue
+        end = pos
+        while not data[end:end + 1].isspace():
+            end += 1
+        tokens.append(data[pos:end])
+        pos = end
+    if tokens[0] != b"P6" or int(tokens[3]) != 255:
+        raise ValueError("only 8-bit binary (P6) PPM is supported")
+    w, h = int(tokens[1]), int(tokens[2])
+    pix = data[pos + 1:pos + 1 + w * h * 3]
+    return w, h, [tuple(pix[i:i + 3]) for i in range(0, len(pix), 3)]
+
+
+def read_image(path):
+    """Width, height and (r, g, b) pixels of an image file"""
+    if path.lower().endswith(".ppm"):
+        return read_ppm(path)
+    try:
+        from PIL import Image  # pylint: disable=import-outside-toplevel
+    except ImportError:
+        sys.exit(f"{path}: install Pillow or convert the image to PPM")
+    img = Image.open(path).convert("RGB")
+    return img.width, img.height, list(img.getdata())
+
+
+def dither(w, pixels):
+    """Pixels quantized to RGB565 levels like lcdConvertRGB888 with
+    RGB_DITHER, for an image drawn at a multiple of 4 in x and y"""
+    out = []
+    for i, (r, g, b) in enumerate(pixels):
+        t = BAYER4[(i // w & 3) * 4 + (i % w & 3)]
+        out.append((min(r + (t >> 1), 255) & 0xF8, min(g + (t >> 2), 255) & 0xFC,
+                    min(b + (t >> 1), 255) & 0xF8))
+    return out
+
+
+def rgb565(pixels):
+    """Native (little endian) RGB565, as the frame buffer holds it"""
+    return b"".join(struct.pack("<H", ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3))
+                    for r, g, b in pixels)
+
+
+def qoi_encode(w, h, pixels):
+    """QOI image of RGB565-quantized pixels, decoded by lcd_qoi.c"""
+    out = bytearray(b"qoif" + struct.pack(">IIBB", w, h, 3, 0))
+    index = [None] * 64
+    prev = (0, 0, 0, 255)
+    run = 0
+    for i, (r, g, b) in enumerate(pixels):
+        p = (r & 0xF8, g & 0xFC, b & 0xF8, 255)
+        if p == prev:
+            run += 1
+            if run == 62 or i == len(pixels) - 1:
+                out.append(0xC0 | (run - 1))
+                run = 0
+            continue
+        if run:
+            out.append(0xC0 | (run - 1))
+            run = 0
+        h_ = (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64
+        if index[h_] == p:
+            out.append(h_)
+        else:
+            index[h_] = p
+            dr, dg, db = ((p[k] - prev[k] + 128) % 256 - 128 for k in range(3))
+            if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                out.append(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))
+            elif -32 <= dg <= 31 and -8 <= dr - dg <= 7 and -8 <= db - dg <= 7:
+                out += bytes([0x80 | (dg + 32), (dr - dg + 8) << 4 | (db - dg + 8)])
+            else:
+                out += bytes([0xFE, p[0], p[1], p[2]])
+        prev = p
+    out += b"\0" * 7 + b"\1"
+    return bytes(out)
+
+
+def read_audio(path, option):
+    """8-bit unsigned samples and the sample rate"""
+    if path.lower().endswith(".wav"):
+        with wave.open(path) as w:
+            if w.getnchannels() != 1 or w.getsampwidth() not in (1, 2):
+                raise ValueError("only 8 or 16 bit mono WAV is supported")
+            frames = w.readframes(w.getnframes())
+            rate = int(option) if option else w.getframerate()
+            if w.getsampwidth() == 2:  # signed 16 bit to unsigned 8 bit
+                frames = bytes((s >> 8) + 128 for s in struct.unpack(f"<{len(frames) // 2}h", frames))
+            return frames, rate
+    if not option:
+        raise ValueError("sample rate option required")
+    data = c_array(path) if path.endswith(".c") else open(path, "rb").read()
+    return data, int(option)
+
+
+def load(kind, path, option):
+    """Type code, data and info words of one manifest entry"""
+    if kind == "raw":
+        with open(path, "rb") as f:
+            return TYPES["raw"], f.read(), (0, 0)
+    if kind == "image":
+        if path.lower().endswith(".qoi"):
+            with open(path, "rb") as f:
+                data = f.read()
+            w, h = struct.unpack(">II", data[4:12])
+            return TYPES["qoi"], data, (w, h)
+        w, h, pixels = read_image(path)
+        options = option.split()
+        if "dither" in options:
+            pixels = dither(w, pixels)
+        if "qoi" in options:
+            return TYPES["qoi"], qoi_encode(w, h, pixels), (w, h)
+        return TYPES["image"], rgb565(pixels), (w, h)
+    if kind == "font":
+        cw, ch = (int(v) for v in option.lower().split("x"))
+        data = c_array(path) if path.endswith(".c") else open(path, "rb").read()
+        return TYPES["font"], data, (cw, ch)
+    if kind == "audio":
+        data, rate = read_audio(path, option)
+        return TYPES["audio"], data, (rate, 8)
+    raise ValueError(f"unknown type {kind}")
+
+
+def read_manifest(path):
+    """(name, type, file, option) for each line of the manifest"""
+    base = os.path.dirname(os.path.abspath(path))
+    rows = []
+    with open(path, newline="", encoding="utf-8") as f:
+        for row in csv.reader(f):
+            row = [c.strip() for c in row]
+            if not row or not row[0] or row[0].startswith("#"):
+                continue
+            if len(row) < 3:
+                sys.exit(f"{path}: need name, type and file: {row}")
+            name, kind, file = row[:3]
+            option = row[3] if len(row) > 3 else ""
+            if len(name.encode()) > NAME_LEN:
+                sys.exit(f"{path}: name longer than {NAME_LEN}: {name}")
+            rows.append((name, kind, os.path.join(base, file), option))
+    return rows
+
+
+def pack(rows):
+    """Bundle bytes for the loaded manifest rows"""
+    table = 12 + len(rows) * 40
+    entries = bytearray()
+    data = bytearray()
+    for name, kind, path, option in rows:
+        try:
+            code, blob, info = load(kind, path, option)
+        except (OSError, ValueError) as e:
+            sys.exit(f"{name}: {e}")
+        data += b"\0" * (-(table + len(data)) % ALIGN)
+        entries += struct.pack("<20sB3xII2I", name.encode(), code, table + len(data), len(blob), *info)
+        data += blob
+    size = table + len(data)
+    return MAGIC + struct.pack("<HHI", VERSION, len(rows), size) + entries + data
+
+
+def write_header(path, rows):
+    """C header of asset IDs, in manifest order"""
+    with open(path, "w", encoding="ascii") as f:
+        f.write("// Generated by pack_assets.py, do not edit.\n\n")
+        f.write("#ifndef ASSET_IDS_H_\n#define ASSET_IDS_H_\n\n")
+        for i, (name, _, _, _) in enumerate(rows):
+            f.write(f"#define ASSET_ID_{re.sub(r'[^A-Z0-9]', '_', name.upper())} {i}\n")
+        f.write("\n#endif // ASSET_IDS_H_\n")
+
+
+def main():
+    """Pack the manifest named on the command line"""
+    parser = argparse.ArgumentParser(description="Pack assets into a bundle")
+    parser.add_argument("manifest")
+    parser.add_argument("output")
+    parser.add_argument("--size", type=lambda v: int(v, 0), help="partition size, checked and padded to")
+    parser.add_argument("--header", help="also write asset IDs to this C header")
+    args = parser.parse_args()
+
+    rows = read_manifest(args.manifest)
+    bundle = pack(rows)
+    if args.size:
+        if len(bundle) > args.size:
+            sys.exit(f"bundle is {len(bundle)} bytes, partition is {args.size}")
+        bundle += b"\xff" * (args.size - len(bundle))  # erased flash
+    with open(args.output, "wb") as f:
+        f.write(bundle)
+    if args.header:
+        write_header(args.header, rows)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,53 @@
+# Included by the build for every project that uses the asset component
+
+set(ASSET_PACK_TOOL ${CMAKE_CURRENT_LIST_DIR}/pack_assets.py)
+
+# asset_create_partition_image
+#
+# Pack the assets listed in a manifest into a bundle that fits the data
+# partition named 'partition'. FLASH_IN_PROJECT indicates that the bundle
+# should be flashed with 'idf.py flash'; '<partition>-flash' flashes only
+# the bundle and 'idf.py app-flash' only the code. HEADER also writes the
+# asset IDs to a C header.
+function(asset_create_partition_image partition manifest)
+    set(options FLASH_IN_PROJECT)
+    set(one HEADER)
+    set(multi DEPENDS)
+    cmake_parse_arguments(arg "${options}" "${one}" "${multi}" "${ARGN}")
+
+    idf_build_get_property(python PYTHON)
+    get_filename_component(manifest_full ${manifest} ABSOLUTE)
+    partition_table_get_partition_info(size "--partition-name ${partition}" "size")
+    partition_table_get_partition_info(offset "--partition-name ${partition}" "offset")
+
+    if("${size}" AND "${offset}")
+        set(image_file ${CMAKE_BINARY_DIR}/${partition}.bin)
+        set(header_args)
+        if(arg_HEADER)
+            get_filename_component(header_full ${arg_HEADER} ABSOLUTE)
+            set(header_args --header ${header_full})
+        endif()
+
+        # Always run, the manifest does not list its inputs to CMake
+        add_custom_target(${partition}_bin ALL
+            COMMAND ${python} ${ASSET_PACK_TOOL} ${manifest_full} ${image_file} --size ${size} ${header_args}
+            DEPENDS ${manifest_full} ${arg_DEPENDS}
+            VERBATIM)
+        set_property(DIRECTORY "${CMAKE_CURRENT_SOURCE_DIR}" APPEND PROPERTY
+            ADDITIONAL_CLEAN_FILES ${image_file})
+
+        idf_component_get_property(main_args esptool_py FLASH_ARGS)
+        idf_component_get_property(sub_args esptool_py FLASH_SUB_ARGS)
+        esptool_py_flash_target(${partition}-flash "${main_args}" "${sub_args}")
+        esptool_py_flash_target_image(${partition}-flash "${partition}" "${offset}" "${image_file}")
+        add_dependencies(${partition}-flash ${partition}_bin)
+
+        if(arg_FLASH_IN_PROJECT)
+            esptool_py_flash_target_image(flash "${partition}" "${offset}" "${image_file}")
+            add_dependencies(flash ${partition}_bin)
+        endif()
+    else()
+        message(FATAL_ERROR "Failed to create asset bundle for partition '${partition}'. "
+                "Check project configuration if using the correct partition table file.")
+    endif()
+endfunction()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+
+"""
+Generate the lookup tables used by the lcd component.
+Run by the build (see CMakeLists.txt): gen_tables.py <output header>
+"""
+
+import math
+import sys
+
+
+def sin_table():
+    """Quarter wave sine, one entry per degree (0-90), Q15 (1.0 = 32768)"""
+    vals = [round(math.sin(math.radians(d)) * 32768) for d in range(91)]
+    lines = ["// sin(deg) in Q15 for deg = 0 to 90, other quadrants by symmetry"]
+    lines.append("static const uint16_t sin_q15[91] = {")
+    for i in range(0, len(vals), 10):
+        lines.append("\t" + ", ".join(str(v) for v in vals[i:i + 10]) + ",")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+# 4x4 ordered dither thresholds (Bayer), 0-15. pack_assets.py uses the same.
+BAYER4 = [0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5]
+
+
+def table(ctype, name, vals, comment, per_line=12):
+    """C array definition of vals"""
+    lines = [comment, f"static const {ctype} {name}[{len(vals)}] = {{"]
+    for i in range(0, len(vals), per_line):
+        lines.append("\t" + ", ".join(str(v) for v in vals[i:i + per_line]) + ",")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def rgb_tables():
+    """RGB888 to RGB565 channel tables. The index is the channel value plus
+    the dither threshold, up to 7 (5-bit) or 3 (6-bit) past 255, saturated."""
+    return "\n\n".join([
+        table("uint8_t", "bayer4", BAYER4, "// 4x4 ordered dither thresholds, row by row", 16),
+        table("uint16_t", "rgb_r5", [(min(v, 255) & 0xF8) << 8 for v in range(256 + 7)],
+              "// red, 5 bits in place"),
+        table("uint16_t", "rgb_g6", [(min(v, 255) & 0xFC) << 3 for v in range(256 + 3)],
+              "// green, 6 bits in place"),
+        table("uint8_t", "rgb_b5", [min(v, 255) >> 3 for v in range(256 + 7)],
+              "// blue, 5 bits in place", 16),
+    ])
+
+
+# Largest circle radius with precomputed row widths
+CIRCLE_R = 32
+
+
+def circle_widths(r):
+    """Half width of each row of a filled circle of radius r, the same
+    stepping as lcd_circle_widths() in lcd.c"""
+    hw = [0] * (r + 1)
+    x, y, err, change = 0, -r, 2 - 2 * r, True
+    while y <= 0:
+        if change:
+            for dy in range(-y + 1):
+                hw[dy] = x
+        old = err
+        change = old <= x
+        if change:
+            x += 1
+            err += x * 2 + 1
+        if old > y or err > x:
+            y += 1
+            err += y * 2 + 1
+    return hw
+
+
+def circle_table():
+    """Row half widths of the circles of radius 0 to CIRCLE_R, radius r
+    starting at r*(r+1)/2"""
+    vals = [w for r in range(CIRCLE_R + 1) for w in circle_widths(r)]
+    return "\n".join([f"#define CIRCLE_TABLE_R {CIRCLE_R}\n",
+                      table("uint16_t", "circle_hw", vals,
+                            "// filled circle row half widths, radius by radius")])
+
+
+def main():
+    """Write all tables to the header named on the command line"""
+    if len(sys.argv) != 2:
+        sys.exit("usage: gen_tables.py <output header>")
+    tables = [sin_table(), rgb_tables(), circle_table()]
+    with open(sys.argv[1], "w", encoding="ascii") as f:
+        f.write("// Generated by gen_tables.py, do not edit.\n\n")
+        f.write("#ifndef LCD_TABLES_H_\n#define LCD_TABLES_H_\n\n")
+        f.write("#include <stdint.h>\n\n")
+        f.write("\n\n".join(tables))
+        f.write("\n\n#endif // LCD_TABLES_H_\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,8 @@
 /* Modified from: https://github.com/nopnop2002/esp-idf-st7789 */
 
 #include <string.h> // strlen, memcpy
-#include <math.h> // cosf, sinf
+#include <stdlib.h> // abort
+#include <math.h> // sqrtf, floorf
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -12,6 +13,7 @@
 #include "esp_log.h"
 
 #include "lcd.h"
+#include "lcd_tables.h" // generated by gen_tables.py
 
 #define TAG "lcd"
 #define	_DEBUG_ 0
@@ -29,6 +31,14 @@
 #define CONFIG_OFFSETY 0
 #endif
 
+// Controller memory size, the range MADCTL mirroring reflects over
+#ifndef CONFIG_GRAM_WIDTH
+#define CONFIG_GRAM_WIDTH (CONFIG_WIDTH+CONFIG_OFFSETX)
+#endif
+#ifndef CONFIG_GRAM_HEIGHT
+#define CONFIG_GRAM_HEIGHT (CONFIG_HEIGHT+CONFIG_OFFSETY)
+#endif
+
 #ifndef CONFIG_MOSI_GPIO
 #define CONFIG_MOSI_GPIO 23
 #endif
@@ -61,16 +71,28 @@
 #define SPI_DEFAULT_FREQUENCY SPI_MASTER_FREQ_40M; // MHz
 #define swap(T,a,b) {T t = (a); (a) = (b); (b) = t;}
 
-#define M_PIf 3.14159265358979323846f
-
 #define SWAP16(c) (((c) << 8) | ((c) >> 8))
 
+// Memory access control (36h) bits, same on the ILI9341 and ST7789
+#define MADCTL_MY 0x80 // row address order
+#define MADCTL_MX 0x40 // column address order
+#define MADCTL_MV 0x20 // row/column exchange
+#define MADCTL_BASE 0x08 // BGR, the normal scan set by lcdInit
+
 static const int32_t SPI_Command_Mode = 0;
 static const int32_t SPI_Data_Mode = 1;
 
 static int32_t clock_speed_hz = SPI_DEFAULT_FREQUENCY;
 
+// With CONFIG_LCD_FONT_ASSET the glyphs are left out of the app image and
+// text is drawn once the application sets a font, e.g. from the asset
+// bundle with lcdSetFont().
+#ifndef CONFIG_LCD_FONT_ASSET
 #include "glcdfont.c" // unsigned char font[];
+#define LCD_FONT font
+#else
+#define LCD_FONT NULL
+#endif
 
 
 static void delayMS(int32_t ms) {
@@ -83,94 +105,134 @@ static void delayMS(int32_t ms) {
 /* * * * * * * * * * SPI * * * * * * * * * */
 
 #define BUF_LEN 512
-static uint16_t buffer[BUF_LEN];
 
-static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO_RESET, int16_t GPIO_BL)
+static bool spi_master_init(TFT_t *dev, const lcd_config_t *cfg)
 {
 	esp_err_t ret;
 
-	ESP_LOGI(TAG, "GPIO_CS=%hd",GPIO_CS);
-	if ( GPIO_CS >= 0 ) {
-		gpio_reset_pin( GPIO_CS );
-		gpio_set_direction( GPIO_CS, GPIO_MODE_OUTPUT );
-		gpio_set_level( GPIO_CS, 0 );
+	ESP_LOGI(TAG, "GPIO_CS=%hd",cfg->cs);
+	if ( cfg->cs >= 0 ) {
+		gpio_reset_pin( cfg->cs );
+		gpio_set_direction( cfg->cs, GPIO_MODE_OUTPUT );
+		gpio_set_level( cfg->cs, 0 );
 	}
 
-	ESP_LOGI(TAG, "GPIO_DC=%hd",GPIO_DC);
-	gpio_reset_pin( GPIO_DC );
-	gpio_set_direction( GPIO_DC, GPIO_MODE_OUTPUT );
-	gpio_set_level( GPIO_DC, 0 );
+	ESP_LOGI(TAG, "GPIO_DC=%hd",cfg->dc);
+	gpio_reset_pin( cfg->dc );
+	gpio_set_direction( cfg->dc, GPIO_MODE_OUTPUT );
+	gpio_set_level( cfg->dc, 0 );
 
-	ESP_LOGI(TAG, "GPIO_RESET=%hd",GPIO_RESET);
-	if ( GPIO_RESET >= 0 ) {
-		gpio_reset_pin( GPIO_RESET );
-		gpio_set_direction( GPIO_RESET, GPIO_MODE_OUTPUT );
-		gpio_set_level( GPIO_RESET, 1 );
+	ESP_LOGI(TAG, "GPIO_RESET=%hd",cfg->reset);
+	if ( cfg->reset >= 0 ) {
+		gpio_reset_pin( cfg->reset );
+		gpio_set_direction( cfg->reset, GPIO_MODE_OUTPUT );
+		gpio_set_level( cfg->reset, 1 );
 		delayMS(100);
-		gpio_set_level( GPIO_RESET, 0 );
+		gpio_set_level( cfg->reset, 0 );
 		delayMS(100);
-		gpio_set_level( GPIO_RESET, 1 );
+		gpio_set_level( cfg->reset, 1 );
 		delayMS(100);
 	}
 
-	ESP_LOGI(TAG, "GPIO_BL=%hd",GPIO_BL);
-	if ( GPIO_BL >= 0 ) {
-		gpio_reset_pin(GPIO_BL);
-		gpio_set_direction( GPIO_BL, GPIO_MODE_OUTPUT );
-		gpio_set_level( GPIO_BL, 0 );
+	ESP_LOGI(TAG, "GPIO_BL=%hd",cfg->bl);
+	if ( cfg->bl >= 0 ) {
+		gpio_reset_pin(cfg->bl);
+		gpio_set_direction( cfg->bl, GPIO_MODE_OUTPUT );
+		gpio_set_level( cfg->bl, 0 );
 	}
 
-	ESP_LOGI(TAG, "GPIO_MOSI=%hd",GPIO_MOSI);
-	ESP_LOGI(TAG, "GPIO_SCLK=%hd",GPIO_SCLK);
+	ESP_LOGI(TAG, "GPIO_MOSI=%hd",cfg->mosi);
+	ESP_LOGI(TAG, "GPIO_SCLK=%hd",cfg->sclk);
 	spi_bus_config_t buscfg = {
-		.mosi_io_num = GPIO_MOSI,
+		.mosi_io_num = cfg->mosi,
 		.miso_io_num = -1,
-		.sclk_io_num = GPIO_SCLK,
+		.sclk_io_num = cfg->sclk,
 		.quadwp_io_num = -1,
 		.quadhd_io_num = -1,
 		.max_transfer_sz = 0,
 		.flags = 0
 	};
 
-	ret = spi_bus_initialize( HOST_ID, &buscfg, SPI_DMA_CH_AUTO );
+	// The first panel on a host initializes the bus, later ones share it
+	ret = spi_bus_initialize( cfg->host, &buscfg, SPI_DMA_CH_AUTO );
 	ESP_LOGD(TAG, "spi_bus_initialize=%d",(int)ret);
-	assert(ret==ESP_OK);
+	assert(ret==ESP_OK || ret==ESP_ERR_INVALID_STATE);
 
 	spi_device_interface_config_t devcfg;
 	memset(&devcfg, 0, sizeof(devcfg));
-	devcfg.clock_speed_hz = clock_speed_hz;
-	devcfg.queue_size = 7;
+	devcfg.clock_speed_hz = cfg->clock_speed_hz;
+	devcfg.queue_size = CONFIG_DMA_RING;
 	devcfg.mode = 3;
 	devcfg.flags = SPI_DEVICE_NO_DUMMY;
 
-	if ( GPIO_CS >= 0 ) {
-		devcfg.spics_io_num = GPIO_CS;
+	if ( cfg->cs >= 0 ) {
+		devcfg.spics_io_num = cfg->cs;
 	} else {
 		devcfg.spics_io_num = -1;
 	}
 
+	// Staging for the pixel data, the polled buffer then the ring
+	dev->_buffer = heap_caps_malloc(sizeof(uint16_t)*BUF_LEN*(1+CONFIG_DMA_RING), MALLOC_CAP_DMA);
+	if (dev->_buffer == NULL) {
+		ESP_LOGE(TAG, "heap_caps_malloc fail");
+		return false;
+	}
+	dev->_ring = dev->_buffer + BUF_LEN;
+	dev->_queued = 0;
+	dev->_slot = 0;
+
 	spi_device_handle_t handle;
-	ret = spi_bus_add_device( HOST_ID, &devcfg, &handle);
+	ret = spi_bus_add_device( cfg->host, &devcfg, &handle);
 	ESP_LOGD(TAG, "spi_bus_add_device=%d",(int)ret);
 	assert(ret==ESP_OK);
-	dev->_dc = GPIO_DC;
-	dev->_bl = GPIO_BL;
+	dev->_dc = cfg->dc;
+	dev->_dc_level = SPI_Command_Mode;
+	dev->_bl = cfg->bl;
 	dev->_SPIHandle = handle;
+	return true;
+}
+
+// Wait for the queued transactions of the device. They must be done
+// before a polling transfer or a change of the DC line.
+static void spi_master_sync(TFT_t *dev)
+{
+	spi_transaction_t *done;
+	while (dev->_queued) {
+		spi_device_get_trans_result(dev->_SPIHandle, &done, portMAX_DELAY);
+		dev->_queued--;
+	}
 }
 
-static bool spi_master_write_bytes(spi_device_handle_t SPIHandle, const uint8_t* Data, size_t DataLength)
+// Set the DC line, queued data keeps going while the level is unchanged
+static void spi_master_dc(TFT_t *dev, int32_t level)
+{
+	if (level == dev->_dc_level) return;
+	spi_master_sync(dev);
+	gpio_set_level( dev->_dc, level );
+	dev->_dc_level = level;
+}
+
+// Polled write. Up to 4 bytes go in the transaction itself, so callers
+// may pass data on their stack.
+static bool spi_master_write_bytes(TFT_t *dev, const uint8_t* Data, size_t DataLength)
 {
 	spi_transaction_t SPITransaction;
 	esp_err_t ret;
 
 	if ( DataLength > 0 ) {
+		spi_master_sync(dev);
 		memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
 		SPITransaction.length = DataLength * 8;
-		SPITransaction.tx_buffer = Data;
+		if ( DataLength <= sizeof(SPITransaction.tx_data) ) {
+			SPITransaction.flags = SPI_TRANS_USE_TXDATA;
+			memcpy( SPITransaction.tx_data, Data, DataLength );
+		} else {
+			SPITransaction.tx_buffer = Data;
+		}
 #if 0
-		ret = spi_device_transmit( SPIHandle, &SPITransaction );
+		ret = spi_device_transmit( dev->_SPIHandle, &SPITransaction );
 #else
-		ret = spi_device_polling_transmit( SPIHandle, &SPITransaction );
+		ret = spi_device_polling_transmit( dev->_SPIHandle, &SPITransaction );
 #endif
 		assert(ret==ESP_OK);
 	}
@@ -180,40 +242,36 @@ static bool spi_master_write_bytes(spi_device_handle_t SPIHandle, const uint8_t*
 
 static bool spi_master_write_command(TFT_t *dev, uint8_t cmd)
 {
-	static uint8_t Byte = 0;
-	Byte = cmd;
-	gpio_set_level( dev->_dc, SPI_Command_Mode );
-	return spi_master_write_bytes( dev->_SPIHandle, &Byte, 1 );
+	spi_master_dc( dev, SPI_Command_Mode );
+	return spi_master_write_bytes( dev, &cmd, 1 );
 }
 
 static bool spi_master_write_data_byte(TFT_t *dev, uint8_t data)
 {
-	static uint8_t Byte = 0;
-	Byte = data;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->_SPIHandle, &Byte, 1 );
+	spi_master_dc( dev, SPI_Data_Mode );
+	return spi_master_write_bytes( dev, &data, 1 );
 }
 
 #if 0
 static bool spi_master_write_data_word(TFT_t *dev, uint16_t data)
 {
-	static uint8_t Byte[2];
+	uint8_t Byte[2];
 	Byte[0] = (data >> 8) & 0xFF;
 	Byte[1] = data & 0xFF;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->_SPIHandle, Byte, 2);
+	spi_master_dc( dev, SPI_Data_Mode );
+	return spi_master_write_bytes( dev, Byte, 2);
 }
 #endif
 
 static bool spi_master_write_addr(TFT_t *dev, uint16_t addr1, uint16_t addr2)
 {
-	static uint8_t Byte[4];
+	uint8_t Byte[4];
 	Byte[0] = (addr1 >> 8) & 0xFF;
 	Byte[1] = addr1 & 0xFF;
 	Byte[2] = (addr2 >> 8) & 0xFF;
 	Byte[3] = addr2 & 0xFF;
-	gpio_set_level( dev->_dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->_SPIHandle, Byte, 4);
+	spi_master_dc( dev, SPI_Data_Mode );
+	return spi_master_write_bytes( dev, Byte, 4);
 }
 
 // size is number of elements, not bytes.
@@ -221,11 +279,11 @@ inline static bool spi_master_write_color(TFT_t *dev, uint16_t color, size_t siz
 {
 	uint16_t temp = SWAP16(color);
 	size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-	for (size_t i = 0; i < n; i++) buffer[i] = temp;
-	gpio_set_level(dev->_dc, SPI_Data_Mode);
+	spi_master_dc(dev, SPI_Data_Mode);
+	for (size_t i = 0; i < n; i++) dev->_buffer[i] = temp;
 	while (size) {
 		n = (size < BUF_LEN) ? size : BUF_LEN;
-		spi_master_write_bytes(dev->_SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+		spi_master_write_bytes(dev, (uint8_t *)dev->_buffer, n*sizeof(uint16_t));
 		size -= n;
 	}
 	return true;
@@ -284,43 +342,317 @@ inline static bool spi_master_write_colors(TFT_t *dev, uint16_t *colors, uint16_
 }
 #endif
 
+// Send a block of pixels, row by row, as one stream of data bytes.
+// Chunks are swapped into the staging ring of the device and queued on
+// the SPI driver: while DMA sends one buffer the CPU fills the next. The
+// last chunks are still in flight on return, the pixels may be reused.
+// w,h: block size
+// stride: elements between rows of the block
+static bool spi_master_write_rows(TFT_t *dev, const uint16_t *pixels, int32_t w, int32_t h, int32_t stride)
+{
+	spi_transaction_t *done;
+	int32_t i = 0;
+	spi_master_dc(dev, SPI_Data_Mode);
+	while (h) {
+		if (dev->_queued == CONFIG_DMA_RING) { // wait for the oldest, it is in this slot
+			spi_device_get_trans_result(dev->_SPIHandle, &done, portMAX_DELAY);
+			dev->_queued--;
+		}
+		uint16_t *buf = dev->_ring + dev->_slot*BUF_LEN;
+		int32_t n = 0;
+		while (n < BUF_LEN && h) {
+			int32_t m = (BUF_LEN-n < w-i) ? BUF_LEN-n : w-i;
+			for (int32_t k = 0; k < m; k++) buf[n+k] = SWAP16(pixels[i+k]);
+			n += m;
+			i += m;
+			if (i == w) {i = 0; pixels += stride; h--;}
+		}
+		spi_transaction_t *t = &dev->_trans[dev->_slot];
+		memset(t, 0, sizeof(spi_transaction_t));
+		t->length = n*sizeof(uint16_t)*8;
+		t->tx_buffer = buf;
+		esp_err_t ret = spi_device_queue_trans(dev->_SPIHandle, t, portMAX_DELAY);
+		assert(ret==ESP_OK);
+		dev->_queued++;
+		if (++dev->_slot == CONFIG_DMA_RING) dev->_slot = 0;
+	}
+	return true;
+}
+
 // size is number of elements, not bytes.
 inline static bool spi_master_write_colors(TFT_t *dev, uint16_t *colors, size_t size)
 {
-	gpio_set_level(dev->_dc, SPI_Data_Mode);
-	while (size) {
-		size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-		for (size_t i = 0; i < n; i++) buffer[i] = SWAP16(colors[i]);
-		spi_master_write_bytes(dev->_SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
-		colors += n;
-		size -= n;
-	}
+	if (size > BUF_LEN) return spi_master_write_rows(dev, colors, size, 1, size);
+	spi_master_dc(dev, SPI_Data_Mode);
+	for (size_t i = 0; i < size; i++) dev->_buffer[i] = SWAP16(colors[i]);
+	spi_master_write_bytes(dev, (uint8_t *)dev->_buffer, size*sizeof(uint16_t));
 	return true;
 }
 
 
 /* * * * * * * * * * LCD * * * * * * * * * */
 
+// Set the display window (screen coordinates) and start a memory write.
+// Pixel data for the window follows with spi_master_write_color(s).
+static void lcd_set_window(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	spi_master_write_command(dev, 0x2A);	// set column(x) address
+	spi_master_write_addr(dev, x1 + dev->_offsetx, x2 + dev->_offsetx);
+	spi_master_write_command(dev, 0x2B);	// set Page(y) address
+	spi_master_write_addr(dev, y1 + dev->_offsety, y2 + dev->_offsety);
+	spi_master_write_command(dev, 0x2C);	// Memory Write
+}
+
+// Screen position of point (u, v) of a block drawn from (x, y) in direction
+// dir: u runs along a text line (the block width), v across it. The block
+// is turned clockwise by the direction angle about (x, y).
+static inline void lcd_dir_map(direction_t dir, int32_t x, int32_t y, int32_t u, int32_t v, int32_t *px, int32_t *py)
+{
+	switch (dir) {
+	case DIRECTION90:  *px = x-v; *py = y+u; break;
+	case DIRECTION180: *px = x-u; *py = y-v; break;
+	case DIRECTION270: *px = x+v; *py = y-u; break;
+	default:           *px = x+u; *py = y+v; break;
+	}
+}
+
+// Inverse of lcd_dir_map
+static inline void lcd_dir_unmap(direction_t dir, int32_t x, int32_t y, int32_t px, int32_t py, int32_t *u, int32_t *v)
+{
+	switch (dir) {
+	case DIRECTION90:  *u = py-y; *v = x-px; break;
+	case DIRECTION180: *u = x-px; *v = y-py; break;
+	case DIRECTION270: *u = y-py; *v = px-x; break;
+	default:           *u = px-x; *v = py-y; break;
+	}
+}
+
+// Clip a w by h block drawn from (x, y) in direction dir.
+// t: visible part in block coordinates (u, v)
+// r: visible part on screen
+// Return false if nothing is visible.
+static bool lcd_dir_clip(TFT_t *dev, direction_t dir, int32_t x, int32_t y, int32_t w, int32_t h, rect_t *t, rect_t *r)
+{
+	int32_t ax, ay, bx, by;
+	if (w <= 0 || h <= 0) return false;
+	lcd_dir_map(dir, x, y, 0, 0, &ax, &ay);
+	lcd_dir_map(dir, x, y, w-1, h-1, &bx, &by);
+	r->x1 = (ax < bx) ? ax : bx; r->x2 = (ax < bx) ? bx : ax;
+	r->y1 = (ay < by) ? ay : by; r->y2 = (ay < by) ? by : ay;
+	if (r->x2 < 0 || r->x1 >= dev->_width) return false; // off screen
+	if (r->y2 < 0 || r->y1 >= dev->_height) return false;
+	if (r->x1 < 0) r->x1 = 0; // clip
+	if (r->x2 >= dev->_width) r->x2 = dev->_width-1;
+	if (r->y1 < 0) r->y1 = 0;
+	if (r->y2 >= dev->_height) r->y2 = dev->_height-1;
+	lcd_dir_unmap(dir, x, y, r->x1, r->y1, &ax, &ay);
+	lcd_dir_unmap(dir, x, y, r->x2, r->y2, &bx, &by);
+	t->x1 = (ax < bx) ? ax : bx; t->x2 = (ax < bx) ? bx : ax;
+	t->y1 = (ay < by) ? ay : by; t->y2 = (ay < by) ? by : ay;
+	return true;
+}
+
+// Frame buffer step between neighbours along u for direction dir
+static inline int32_t lcd_dir_step(TFT_t *dev, direction_t dir)
+{
+	switch (dir) {
+	case DIRECTION90:  return dev->_width;
+	case DIRECTION180: return -1;
+	case DIRECTION270: return -dev->_width;
+	default:           return 1;
+	}
+}
+
+// Set the window r (screen coordinates) for pixels streamed in block order
+// of direction dir, v rows of u. For the rotated directions the scan order
+// of the controller is changed with MADCTL, so the rows stream like
+// unrotated ones; lcd_madctl_restore must follow the pixel data.
+static void lcd_set_window_dir(TFT_t *dev, direction_t dir, const rect_t *r)
+{
+	int32_t px1 = r->x1 + dev->_offsetx, px2 = r->x2 + dev->_offsetx;
+	int32_t py1 = r->y1 + dev->_offsety, py2 = r->y2 + dev->_offsety;
+	int32_t c1, c2, p1, p2;
+	uint8_t madctl;
+	switch (dir) {
+	case DIRECTION90: // u down the screen, v to the left
+		madctl = MADCTL_MV|MADCTL_MX;
+		c1 = py1; c2 = py2;
+		p1 = dev->_gram_width-1-px2; p2 = dev->_gram_width-1-px1;
+		break;
+	case DIRECTION180: // u to the left, v up
+		madctl = MADCTL_MX|MADCTL_MY;
+		c1 = dev->_gram_width-1-px2; c2 = dev->_gram_width-1-px1;
+		p1 = dev->_gram_height-1-py2; p2 = dev->_gram_height-1-py1;
+		break;
+	case DIRECTION270: // u up the screen, v to the right
+		madctl = MADCTL_MV|MADCTL_MY;
+		c1 = dev->_gram_height-1-py2; c2 = dev->_gram_height-1-py1;
+		p1 = px1; p2 = px2;
+		break;
+	default:
+		lcd_set_window(dev, r->x1, r->y1, r->x2, r->y2);
+		return;
+	}
+	spi_master_write_command(dev, 0x36);	// Memory Access Control
+	spi_master_write_data_byte(dev, MADCTL_BASE ^ madctl);
+	spi_master_write_command(dev, 0x2A);	// set column address, scanned first
+	spi_master_write_addr(dev, c1, c2);
+	spi_master_write_command(dev, 0x2B);	// set page address
+	spi_master_write_addr(dev, p1, p2);
+	spi_master_write_command(dev, 0x2C);	// Memory Write
+}
+
+// Back to the normal scan after a rotated window write
+static void lcd_madctl_restore(TFT_t *dev, direction_t dir)
+{
+	if (dir == DIRECTION0) return;
+	spi_master_write_command(dev, 0x36);	// Memory Access Control
+	spi_master_write_data_byte(dev, MADCTL_BASE);
+}
+
+// Start a direct mode window write for pixels streamed with lcdWindowWrite.
+// The window must be on screen, the caller clips.
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+void lcdWindowBegin(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	lcd_set_window(dev, x1, y1, x2, y2);
+}
+
+// Send the next pixels of the window started by lcdWindowBegin, row by row
+// colors:pixels
+// size:number of pixels
+void lcdWindowWrite(TFT_t *dev, const uint16_t *colors, size_t size)
+{
+	spi_master_write_colors(dev, (uint16_t *)colors, size);
+}
+
+// Draw a block of pixels with clipping. In direct mode the clipped block
+// is sent in one window, not one per row.
+// x:X coordinate of the block
+// y:Y coordinate of the block
+// w:block width
+// h:block height
+// pixels:block colors
+// stride:elements between rows of the block
+void lcdDrawBitmap(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, int32_t stride)
+{
+	int32_t x1 = x, x2 = x+w-1;
+	int32_t y1 = y, y2 = y+h-1;
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+	pixels += (y1-y)*stride + (x1-x);
+	int32_t n = x2-x1+1;
+
+	if (dev->_use_frame_buffer) {
+		uint16_t *dst = dev->_frame_buffer + y1*dev->_width + x1;
+		for (int32_t j = y1; j <= y2; j++, dst += dev->_width, pixels += stride) {
+			memcpy(dst, pixels, n*sizeof(uint16_t));
+		}
+	} else {
+		lcd_set_window(dev, x1, y1, x2, y2);
+		if (n == stride) { // contiguous, one run
+			spi_master_write_colors(dev, (uint16_t *)pixels, n*(y2-y1+1));
+		} else {
+			spi_master_write_rows(dev, pixels, n, y2-y1+1, stride);
+		}
+	}
+}
+
+// Draw a block of pixels turned clockwise by dir about (x, y), where
+// pixel (0, 0) of the block lands. In direct mode the controller scan
+// order is changed for the window so rows still stream; in frame buffer
+// mode rows are stored with a stride.
+// x:X coordinate
+// y:Y coordinate
+// w:block width
+// h:block height
+// pixels:block colors
+// stride:elements between rows of the block
+// dir:direction
+void lcdDrawBitmapRotated(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, int32_t stride, direction_t dir)
+{
+	rect_t t, r; // visible part, block (u, v) and screen
+	if (dir == DIRECTION0) {
+		lcdDrawBitmap(dev, x, y, w, h, pixels, stride);
+		return;
+	}
+	if (!lcd_dir_clip(dev, dir, x, y, w, h, &t, &r)) return;
+	pixels += t.y1*stride + t.x1;
+	int32_t n = t.x2-t.x1+1;
+
+	if (dev->_use_frame_buffer) {
+		int32_t step = lcd_dir_step(dev, dir);
+		for (int32_t v = t.y1; v <= t.y2; v++, pixels += stride) {
+			int32_t px, py;
+			lcd_dir_map(dir, x, y, t.x1, v, &px, &py);
+			uint16_t *dst = dev->_frame_buffer + py*dev->_width + px;
+			for (int32_t k = 0; k < n; k++, dst += step) *dst = pixels[k];
+		}
+	} else {
+		lcd_set_window_dir(dev, dir, &r);
+		spi_master_write_rows(dev, pixels, n, t.y2-t.y1+1, stride);
+		lcd_madctl_restore(dev, dir);
+	}
+}
+
+// Initialize the panel set up by the CONFIG_ options. Stop if it cannot
+// be set up; use lcdInitConfig to handle the failure instead.
 void lcdInit(TFT_t *dev)
 {
-	spi_master_init(dev,
-		CONFIG_MOSI_GPIO,
-		CONFIG_SCLK_GPIO,
-		CONFIG_CS_GPIO,
-		CONFIG_DC_GPIO,
-		CONFIG_RESET_GPIO,
-		CONFIG_BL_GPIO);
-
-	dev->_width = CONFIG_WIDTH;
-	dev->_height = CONFIG_HEIGHT;
-	dev->_offsetx = CONFIG_OFFSETX;
-	dev->_offsety = CONFIG_OFFSETY;
+	lcd_config_t cfg = {
+		.host = HOST_ID,
+		.mosi = CONFIG_MOSI_GPIO,
+		.sclk = CONFIG_SCLK_GPIO,
+		.cs = CONFIG_CS_GPIO,
+		.dc = CONFIG_DC_GPIO,
+		.reset = CONFIG_RESET_GPIO,
+		.bl = CONFIG_BL_GPIO,
+		.clock_speed_hz = clock_speed_hz,
+		.width = CONFIG_WIDTH,
+		.height = CONFIG_HEIGHT,
+		.offsetx = CONFIG_OFFSETX,
+		.offsety = CONFIG_OFFSETY,
+		.gram_width = CONFIG_GRAM_WIDTH,
+		.gram_height = CONFIG_GRAM_HEIGHT,
+	};
+	if (!lcdInitConfig(dev, &cfg)) {
+		ESP_LOGE(TAG, "lcdInitConfig fail");
+		abort();
+	}
+}
+
+// Initialize a panel. Call once per panel, e.g. two panels on one bus
+// with different CS and DC pins, or one on each SPI host.
+// cfg:wiring and geometry
+bool lcdInitConfig(TFT_t *dev, const lcd_config_t *cfg)
+{
+	if (!spi_master_init(dev, cfg)) return false;
+
+	dev->_width = cfg->width;
+	dev->_height = cfg->height;
+	dev->_offsetx = cfg->offsetx;
+	dev->_offsety = cfg->offsety;
+	dev->_gram_width = cfg->gram_width ? cfg->gram_width : cfg->width + cfg->offsetx;
+	dev->_gram_height = cfg->gram_height ? cfg->gram_height : cfg->height + cfg->offsety;
 	dev->_font_direction = DIRECTION0;
 	dev->_font_size = 1;
 	dev->_font_back_en = false;
 	dev->_font_back_color = BLACK;
+	dev->_font = LCD_FONT;
 	dev->_use_frame_buffer = false;
 	dev->_frame_buffer = NULL;
+	dev->_dirty_count = 0;
+	dev->_drawn_count = 0;
+	dev->_background = NULL;
+	dev->_active_y1 = 0;
+	dev->_active_y2 = dev->_height-1;
 
 	spi_master_write_command(dev, 0x01);	// ILI:Software Reset (01h), ST:SWRESET (01h): Software Reset
 	delayMS(5); // 150
@@ -333,7 +665,7 @@ void lcdInit(TFT_t *dev)
 	// delayMS(10);
 
 	spi_master_write_command(dev, 0x36);	// ILI:Memory Access Control (36h), ST:MADCTL (36h): Memory Data Access Control
-	spi_master_write_data_byte(dev, 0x08);  // 0x00
+	spi_master_write_data_byte(dev, MADCTL_BASE);  // 0x00
 
 	// spi_master_write_command(dev, 0x2A);	// ILI:Column Address Set (2Ah), ST:CASET (2Ah): Column Address Set
 	// spi_master_write_data_byte(dev, 0x00);
@@ -410,6 +742,15 @@ void lcdInit(TFT_t *dev)
 	if(dev->_bl >= 0) {
 		gpio_set_level( dev->_bl, 1 );
 	}
+	return true;
+}
+
+// Wait until the pixel data queued by the device is sent. Drawing calls
+// may return with the last chunks still in flight; the data is staged, so
+// only needed before e.g. powering down the panel.
+void lcdWait(TFT_t *dev)
+{
+	spi_master_sync(dev);
 }
 
 // Fill screen
@@ -557,6 +898,23 @@ void lcdDrawVLine(TFT_t *dev, int32_t x, int32_t y, int32_t h, uint16_t color) {
 	}
 }
 
+// Fill a span of one row, used by the scanline fills.
+// y must be on screen, x1 <= x2 are clipped here.
+static inline void lcd_span(TFT_t *dev, int32_t y, int32_t x1, int32_t x2, uint16_t color)
+{
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+
+	if (dev->_use_frame_buffer) {
+		uint16_t *ptr = dev->_frame_buffer + y*dev->_width + x1;
+		for (int32_t n = x2-x1+1; n > 0; n--) *ptr++ = color;
+	} else {
+		lcd_set_window(dev, x1, y, x2, y);
+		spi_master_write_color(dev, color, x2-x1+1);
+	}
+}
+
 #if 0
 // Draw line
 // x1:Start X coordinate
@@ -771,6 +1129,289 @@ void lcdFillRect(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uin
 	}
 }
 
+// One row of RGB888 to RGB565, four pixels per step. t5 and t6 are the
+// dither thresholds of the columns, in step with the groups of four.
+static inline void lcd_rgb_row(uint16_t *dst, const uint8_t *rgb, int32_t w, const uint8_t *t5, const uint8_t *t6, bool swapped)
+{
+	int32_t i = 0;
+	for (; i+4 <= w; i += 4, rgb += 12, dst += 4) {
+		uint16_t p0 = rgb_r5[rgb[0]+t5[0]] | rgb_g6[rgb[1]+t6[0]]  | rgb_b5[rgb[2]+t5[0]];
+		uint16_t p1 = rgb_r5[rgb[3]+t5[1]] | rgb_g6[rgb[4]+t6[1]]  | rgb_b5[rgb[5]+t5[1]];
+		uint16_t p2 = rgb_r5[rgb[6]+t5[2]] | rgb_g6[rgb[7]+t6[2]]  | rgb_b5[rgb[8]+t5[2]];
+		uint16_t p3 = rgb_r5[rgb[9]+t5[3]] | rgb_g6[rgb[10]+t6[3]] | rgb_b5[rgb[11]+t5[3]];
+		if (swapped) {
+			p0 = SWAP16(p0); p1 = SWAP16(p1); p2 = SWAP16(p2); p3 = SWAP16(p3);
+		}
+		dst[0] = p0; dst[1] = p1; dst[2] = p2; dst[3] = p3;
+	}
+	for (int32_t k = 0; i < w; i++, k++, rgb += 3) {
+		uint16_t p = rgb_r5[rgb[0]+t5[k]] | rgb_g6[rgb[1]+t6[k]] | rgb_b5[rgb[2]+t5[k]];
+		*dst++ = swapped ? SWAP16(p) : p;
+	}
+}
+
+// Convert RGB888 pixels to RGB565 with table lookups
+// dst:w*h pixels
+// rgb:w*h pixels of 3 bytes, r g b
+// w:width
+// h:height
+// x:X coordinate of the first pixel, aligns the dither pattern
+// y:Y coordinate of the first pixel
+// flags:RGB_DITHER, RGB_SWAPPED
+void lcdConvertRGB888(uint16_t *dst, const uint8_t *rgb, int32_t w, int32_t h, int32_t x, int32_t y, uint32_t flags)
+{
+	uint8_t t5[4] = {0}, t6[4] = {0}; // no dither, truncate
+	for (int32_t j = 0; j < h; j++, rgb += 3*w, dst += w) {
+		if (flags & RGB_DITHER) {
+			const uint8_t *b = bayer4 + ((y+j) & 3)*4;
+			for (int32_t k = 0; k < 4; k++) {
+				t5[k] = b[(x+k) & 3] >> 1; // 0-7, one step of 5 bits
+				t6[k] = b[(x+k) & 3] >> 2; // 0-3, one step of 6 bits
+			}
+		}
+		if (flags & RGB_SWAPPED) lcd_rgb_row(dst, rgb, w, t5, t6, true);
+		else lcd_rgb_row(dst, rgb, w, t5, t6, false);
+	}
+}
+
+// Colors of a horizontal gradient from c0 at position 0 to c1 at
+// position len-1, for positions off to off+n-1. Channels step in 16.16.
+static void lcd_gradient_row(uint16_t *row, int32_t n, int32_t off, int32_t len, uint16_t c0, uint16_t c1)
+{
+	int32_t d = (len > 1) ? len-1 : 1;
+	int32_t dr = ((c1 >> 11) - (c0 >> 11)) * 65536 / d;
+	int32_t dg = (((c1 >> 5) & 0x3F) - ((c0 >> 5) & 0x3F)) * 65536 / d;
+	int32_t db = ((c1 & 0x1F) - (c0 & 0x1F)) * 65536 / d;
+	int32_t r = (c0 >> 11) * 65536 + 0x8000 + off*dr;
+	int32_t g = ((c0 >> 5) & 0x3F) * 65536 + 0x8000 + off*dg;
+	int32_t b = (c0 & 0x1F) * 65536 + 0x8000 + off*db;
+	for (int32_t i = 0; i < n; i++, r += dr, g += dg, b += db) {
+		row[i] = ((r >> 16) << 11) | ((g >> 16) << 5) | (b >> 16);
+	}
+}
+
+// Fill rectangle with a horizontal gradient - assume x1 <= x2 && y1 <= y2
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// c0:color at x1
+// c1:color at x2
+// One template row is computed, then copied down the rectangle.
+void lcdFillGradientH(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t c0, uint16_t c1) {
+	int32_t len = x2-x1+1, off = 0;
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) {off = -x1; x1 = 0;} // clip
+	if (x2 >= dev->_width) x2=dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2=dev->_height-1;
+	int32_t n = x2-x1+1;
+
+	if (dev->_use_frame_buffer) {
+		uint16_t *first = dev->_frame_buffer + y1*dev->_width + x1;
+		lcd_gradient_row(first, n, off, len, c0, c1);
+		uint16_t *dst = first + dev->_width;
+		for (int32_t j = y1+1; j <= y2; j++, dst += dev->_width) memcpy(dst, first, n*sizeof(uint16_t));
+	} else {
+		uint16_t row[n];
+		lcd_gradient_row(row, n, off, len, c0, c1);
+		lcd_set_window(dev, x1, y1, x2, y2);
+		for (int32_t j = y1; j <= y2; j++) spi_master_write_colors(dev, row, n);
+	}
+}
+
+// Fill rectangle with a vertical gradient - assume x1 <= x2 && y1 <= y2
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// c0:color at y1
+// c1:color at y2
+// The endpoint colors are blended once per row.
+void lcdFillGradientV(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t c0, uint16_t c1) {
+	int32_t len = y2-y1+1, off = 0;
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2=dev->_width-1;
+	if (y1 < 0) {off = -y1; y1 = 0;}
+	if (y2 >= dev->_height) y2=dev->_height-1;
+	int32_t n = x2-x1+1, h = y2-y1+1;
+
+	uint16_t colors[h];
+	lcd_gradient_row(colors, h, off, len, c0, c1);
+	if (dev->_use_frame_buffer) {
+		uint16_t *dst = dev->_frame_buffer + y1*dev->_width + x1;
+		for (int32_t j = 0; j < h; j++, dst += dev->_width) {
+			for (int32_t i = 0; i < n; i++) dst[i] = colors[j];
+		}
+	} else {
+		lcd_set_window(dev, x1, y1, x2, y2);
+		for (int32_t j = 0; j < h; j++) spi_master_write_color(dev, colors[j], n);
+	}
+}
+
+// Fill rectangle with a repeating 8x8 pattern - assume x1 <= x2 && y1 <= y2
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// pattern:64 colors, row by row. The pattern is aligned to the screen,
+// so neighboring fills line up.
+void lcdFillPattern(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint16_t *pattern) {
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2=dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2=dev->_height-1;
+	int32_t n = x2-x1+1;
+
+	if (dev->_use_frame_buffer) {
+		// build up to 8 template rows in place, then copy them down
+		uint16_t *dst = dev->_frame_buffer + y1*dev->_width + x1;
+		for (int32_t j = y1; j <= y2; j++, dst += dev->_width) {
+			if (j-y1 >= 8) {
+				memcpy(dst, dst - 8*dev->_width, n*sizeof(uint16_t));
+				continue;
+			}
+			const uint16_t *prow = pattern + (j & 7)*8;
+			for (int32_t i = 0; i < n; i++) dst[i] = prow[(x1+i) & 7];
+		}
+	} else {
+		uint16_t row[n];
+		lcd_set_window(dev, x1, y1, x2, y2);
+		for (int32_t j = y1; j <= y2; j++) {
+			const uint16_t *prow = pattern + (j & 7)*8;
+			for (int32_t i = 0; i < n; i++) row[i] = prow[(x1+i) & 7];
+			spi_master_write_colors(dev, row, n);
+		}
+	}
+}
+
+// Two frame buffer pixels accessed as one word
+typedef uint32_t __attribute__((__may_alias__)) pixel2_t;
+
+// Blend two packed RGB565 pixels toward fg by alpha/32 (alpha 0..32).
+// The channels of both pixels are split over two words with a 5 bit gap
+// above each field, so one multiply per word scales three channels:
+//  w & 0x07E0F81F        -> B0 R0 G1 at bits 0, 11, 21
+//  (w >> 5) & 0x07C0F83F -> G0 B1 R1 at bits 0, 11, 22
+static inline uint32_t lcd_blend2(uint32_t fg, uint32_t bg, uint32_t alpha)
+{
+	uint32_t fa = fg & 0x07E0F81F, ba = bg & 0x07E0F81F;
+	uint32_t fb = (fg >> 5) & 0x07C0F83F, bb = (bg >> 5) & 0x07C0F83F;
+	ba = ((((fa - ba) * alpha) >> 5) + ba) & 0x07E0F81F;
+	bb = ((((fb - bb) * alpha) >> 5) + bb) & 0x07C0F83F;
+	return ba | (bb << 5);
+}
+
+// Blend n pixels of dst toward a solid color, two pixels per word
+static void lcd_blend_color(uint16_t *dst, int32_t n, uint16_t color, uint32_t alpha)
+{
+	uint32_t fg = color | (uint32_t)color << 16;
+	if (n > 0 && ((uintptr_t)dst & 2)) { // align to a word
+		*dst = lcd_blend2(color, *dst, alpha);
+		dst++; n--;
+	}
+	pixel2_t *dst2 = (pixel2_t *)dst;
+	for (; n >= 2; n -= 2, dst2++) *dst2 = lcd_blend2(fg, *dst2, alpha);
+	if (n) *(uint16_t *)dst2 = lcd_blend2(color, *(uint16_t *)dst2, alpha);
+}
+
+// Blend n pixels of dst toward src, two pixels per word
+static void lcd_blend_pixels(uint16_t *dst, const uint16_t *src, int32_t n, uint32_t alpha)
+{
+	if (n > 0 && ((uintptr_t)dst & 2)) { // align dst to a word
+		*dst = lcd_blend2(*src++, *dst, alpha);
+		dst++; n--;
+	}
+	pixel2_t *dst2 = (pixel2_t *)dst;
+	if (((uintptr_t)src & 2) == 0) {
+		const pixel2_t *src2 = (const pixel2_t *)src;
+		for (; n >= 2; n -= 2, dst2++) *dst2 = lcd_blend2(*src2++, *dst2, alpha);
+		src = (const uint16_t *)src2;
+	} else {
+		for (; n >= 2; n -= 2, src += 2, dst2++) {
+			*dst2 = lcd_blend2(src[0] | (uint32_t)src[1] << 16, *dst2, alpha);
+		}
+	}
+	if (n) *(uint16_t *)dst2 = lcd_blend2(*src, *(uint16_t *)dst2, alpha);
+}
+
+// Draw translucent horizontal line - frame buffer only
+// x:X coordinate
+// y:Y coordinate
+// w:width of line
+// color:color
+// alpha:opacity 0 (none) to 32 (opaque)
+void lcdDrawHLineAlpha(TFT_t *dev, int32_t x, int32_t y, int32_t w, uint16_t color, uint8_t alpha) {
+	if (dev->_use_frame_buffer == false || alpha == 0) return;
+	if (alpha >= 32) {
+		lcdDrawHLine(dev, x, y, w, color);
+		return;
+	}
+	if (x+w <= 0 || x >= dev->_width) return; // off screen
+	if (y < 0 || y >= dev->_height) return;
+	if (x < 0) {w += x; x = 0;} // clip
+	if (x+w > dev->_width) w = dev->_width-x;
+
+	lcd_blend_color(dev->_frame_buffer + y*dev->_width + x, w, color, alpha);
+}
+
+// Draw translucent rectangle of filling - frame buffer only
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// color:color
+// alpha:opacity 0 (none) to 32 (opaque)
+void lcdFillRectAlpha(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color, uint8_t alpha) {
+	if (dev->_use_frame_buffer == false || alpha == 0) return;
+	if (alpha >= 32) {
+		lcdFillRect(dev, x1, y1, x2, y2, color);
+		return;
+	}
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2=dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2=dev->_height-1;
+
+	uint16_t *dst = dev->_frame_buffer + y1*dev->_width + x1;
+	for (int32_t j = y1; j <= y2; j++, dst += dev->_width) {
+		lcd_blend_color(dst, x2-x1+1, color, alpha);
+	}
+}
+
+// Draw translucent bitmap - frame buffer only
+// x:X coordinate of top left
+// y:Y coordinate of top left
+// w:width of bitmap
+// h:height of bitmap
+// pixels:w*h RGB565 pixels, row by row
+// alpha:opacity 0 (none) to 32 (opaque)
+void lcdDrawBitmapAlpha(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, uint8_t alpha) {
+	if (dev->_use_frame_buffer == false || alpha == 0) return;
+	if (alpha > 32) alpha = 32;
+	int32_t x1 = x, x2 = x+w-1;
+	int32_t y1 = y, y2 = y+h-1;
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+	pixels += (y1-y)*w + (x1-x);
+
+	uint16_t *dst = dev->_frame_buffer + y1*dev->_width + x1;
+	for (int32_t j = y1; j <= y2; j++, dst += dev->_width, pixels += w) {
+		lcd_blend_pixels(dst, pixels, x2-x1+1, alpha);
+	}
+}
+
 /***************************************************************************************
 ** Function name:           lcdDrawTri
 ** Description:             Draw a triangle outline using 3 arbitrary points
@@ -787,7 +1428,8 @@ void lcdDrawTri(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int3
 ** Function name:           lcdFillTri
 ** Description:             Draw a filled triangle using 3 arbitrary points
 ***************************************************************************************/
-// Fill a triangle - original Adafruit function works well and code footprint is small
+// Fill a triangle - based on the original Adafruit function, with the
+// scanline crossings stepped in fixed point and spans written directly
 void lcdFillTri(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
 {
   int32_t a, b, y, last;
@@ -813,80 +1455,379 @@ void lcdFillTri(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int3
     return;
   }
 
+  if (y2 < 0 || y0 >= dev->_height) return; // off screen
+
   int32_t
   dx01 = x1 - x0,
   dy01 = y1 - y0,
   dx02 = x2 - x0,
   dy02 = y2 - y0,
   dx12 = x2 - x1,
-  dy12 = y2 - y1,
-  sa   = 0,
-  sb   = 0;
+  dy12 = y2 - y1;
+
+  // Scanline crossings step in 16.16 fixed point, one division per edge
+  // instead of two per scanline. x is offset by a half so >> 16 rounds.
+  int32_t
+  s01 = dy01 ? dx01 * 65536 / dy01 : 0,
+  s02 = dx02 * 65536 / dy02,
+  s12 = dy12 ? dx12 * 65536 / dy12 : 0;
 
   // For upper part of triangle, find scanline crossings for segments
   // 0-1 and 0-2.  If y1=y2 (flat-bottomed triangle), the scanline y1
-  // is included here (and second loop will be skipped, avoiding a /0
-  // error there), otherwise scanline y1 is skipped here and handled
-  // in the second loop...which also avoids a /0 error here if y0=y1
-  // (flat-topped triangle).
+  // is included here (and second loop will be skipped), otherwise
+  // scanline y1 is skipped here and handled in the second loop.
   if (y1 == y2) last = y1;  // Include y1 scanline
   else          last = y1 - 1; // Skip it
 
-  for (y = y0; y <= last; y++) {
-    a   = x0 + sa / dy01;
-    b   = x0 + sb / dy02;
-    sa += dx01;
-    sb += dx02;
+  // Clip scanlines to the screen up front
+  y = (y0 < 0) ? 0 : y0;
+  int32_t yend = (last < dev->_height) ? last : dev->_height-1;
+  int32_t
+  sa = x0 * 65536 + 0x8000 + (y - y0) * s01,
+  sb = x0 * 65536 + 0x8000 + (y - y0) * s02;
+  for (; y <= yend; y++) {
+    a = sa >> 16;
+    b = sb >> 16;
+    sa += s01;
+    sb += s02;
 
     if (a > b) swap(int32_t, a, b);
-	lcdDrawHLine(dev, a, y, b - a + 1, color);
+    lcd_span(dev, y, a, b, color);
   }
 
   // For lower part of triangle, find scanline crossings for segments
   // 0-2 and 1-2.  This loop is skipped if y1=y2.
-  sa = dx12 * (y - y1);
-  sb = dx02 * (y - y0);
-  for (; y <= y2; y++) {
-    a   = x1 + sa / dy12;
-    b   = x0 + sb / dy02;
-    sa += dx12;
-    sb += dx02;
+  if (y < last+1) y = last+1;
+  yend = (y2 < dev->_height) ? y2 : dev->_height-1;
+  sa = x1 * 65536 + 0x8000 + (y - y1) * s12;
+  sb = x0 * 65536 + 0x8000 + (y - y0) * s02;
+  for (; y <= yend; y++) {
+    a = sa >> 16;
+    b = sb >> 16;
+    sa += s12;
+    sb += s02;
 
     if (a > b) swap(int32_t, a, b);
-	lcdDrawHLine(dev, a, y, b - a + 1, color);
+    lcd_span(dev, y, a, b, color);
   }
 }
 
-// Draw circle
-// x0:Central X coordinate
-// y0:Central Y coordinate
-// r:radius
-// color:color
-void lcdDrawCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color) {
-	int32_t x;
-	int32_t y;
-	int32_t err;
-	int32_t old_err;
+// Fill a batch of triangles that share vertices, such as a ship mesh
+// verts:vertices
+// indices:three vertex indices per triangle
+// n:number of triangles
+// colors:one color per triangle
+void lcdFillTris(TFT_t *dev, const point_t *verts, const uint16_t *indices, int32_t n, const uint16_t *colors)
+{
+  for (int32_t i = 0; i < n; i++, indices += 3) {
+    const point_t *p0 = &verts[indices[0]];
+    const point_t *p1 = &verts[indices[1]];
+    const point_t *p2 = &verts[indices[2]];
+    lcdFillTri(dev, p0->x, p0->y, p1->x, p1->y, p2->x, p2->y, colors[i]);
+  }
+}
 
-	x=0;
-	y=-r;
-	err=2-2*r;
-	do{
-		lcdDrawPixel(dev, x0-x, y0+y, color);
-		lcdDrawPixel(dev, x0-y, y0-x, color);
-		lcdDrawPixel(dev, x0+x, y0-y, color);
-		lcdDrawPixel(dev, x0+y, y0+x, color);
-		if ((old_err=err)<=x)	err+=++x*2+1;
-		if (old_err>y || err>x) err+=++y*2+1;
-	} while(y<0);
+// Polygon edge for the scanline fill, x in 16.16 fixed point
+typedef struct {
+	int32_t y1;  // first scanline crossed
+	int32_t y2;  // scanline after the last one crossed
+	int32_t x;   // x at the center of the current scanline
+	int32_t dx;  // x step per scanline
+	int32_t dir; // winding direction, +1 down and -1 up
+} edge_t;
+
+// Make an edge from (xa, ya) to (xb, yb).
+// Return false if the edge is horizontal and can be skipped.
+static bool lcd_edge(edge_t *e, int32_t xa, int32_t ya, int32_t xb, int32_t yb)
+{
+	if (ya == yb) return false;
+	e->dir = 1;
+	if (ya > yb) {
+		swap(int32_t, xa, xb); swap(int32_t, ya, yb);
+		e->dir = -1;
+	}
+	e->y1 = ya;
+	e->y2 = yb;
+	e->dx = (xb-xa) * 65536 / (yb-ya);
+	e->x = xa * 65536 + e->dx / 2; // sample at pixel centers
+	return true;
+}
+
+// Fill the area enclosed by a set of edges with the nonzero winding rule,
+// using an active edge table and integer edge stepping. Scanlines and
+// pixels are included when their centers are inside, so shapes that
+// share an edge never draw the same pixel twice.
+static void lcd_fill_edges(TFT_t *dev, edge_t *edges, int32_t ne, uint16_t color)
+{
+	if (ne < 2) return;
+
+	edge_t *sorted[ne], *active[ne];
+	int32_t na = 0, next = 0;
+	int32_t ymin = INT32_MAX, ymax = INT32_MIN;
+
+	// sort edges by first scanline
+	for (int32_t i = 0; i < ne; i++) {
+		edge_t *e = &edges[i];
+		int32_t j = i;
+		for (; j > 0 && sorted[j-1]->y1 > e->y1; j--) sorted[j] = sorted[j-1];
+		sorted[j] = e;
+		if (e->y1 < ymin) ymin = e->y1;
+		if (e->y2 > ymax) ymax = e->y2;
+	}
+	if (ymin < 0) ymin = 0; // clip
+	if (ymax > dev->_height) ymax = dev->_height;
+
+	for (int32_t y = ymin; y < ymax; y++) {
+		// remove finished edges
+		int32_t k = 0;
+		for (int32_t i = 0; i < na; i++) {
+			if (active[i]->y2 > y) active[k++] = active[i];
+		}
+		na = k;
+		// add edges starting on (or clipped above) this scanline
+		for (; next < ne && sorted[next]->y1 <= y; next++) {
+			edge_t *e = sorted[next];
+			if (e->y2 <= y) continue;
+			if (e->y1 < y) e->x += (y - e->y1) * e->dx;
+			active[na++] = e;
+		}
+		// keep active edges sorted by x, nearly sorted from the last row
+		for (int32_t i = 1; i < na; i++) {
+			edge_t *e = active[i];
+			int32_t j = i;
+			for (; j > 0 && active[j-1]->x > e->x; j--) active[j] = active[j-1];
+			active[j] = e;
+		}
+		// fill spans where the winding number is nonzero
+		int32_t wind = 0, xl = 0;
+		for (int32_t i = 0; i < na; i++) {
+			edge_t *e = active[i];
+			if (wind == 0) xl = e->x;
+			wind += e->dir;
+			if (wind == 0) {
+				int32_t x1 = (xl + 0x7FFF) >> 16;
+				int32_t x2 = ((e->x + 0x7FFF) >> 16) - 1;
+				if (x1 <= x2) lcd_span(dev, y, x1, x2, color);
+			}
+			e->x += e->dx;
+		}
+	}
+}
+
+// Fill polygon, convex or concave
+// points:vertices, the last connects back to the first
+// n:number of vertices
+// color:color
+void lcdFillPolygon(TFT_t *dev, const point_t *points, int32_t n, uint16_t color)
+{
+	if (n < 3) return;
+	edge_t edges[n];
+	int32_t ne = 0;
+
+	for (int32_t i = 0, j = n-1; i < n; j = i++) {
+		if (lcd_edge(&edges[ne], points[j].x, points[j].y, points[i].x, points[i].y)) ne++;
+	}
+	lcd_fill_edges(dev, edges, ne, color);
+}
+
+// Segments of a thick polyline filled together. Longer lines are filled
+// in batches, which may write the pixels of a join between batches twice.
+// The closing join of an outline is filled with the last batch.
+#ifndef CONFIG_STROKE_BATCH
+#define CONFIG_STROKE_BATCH 4
+#endif
+
+// One segment of a stroke: unit direction, half width offset and the
+// corners on the left (+offset) and right (-offset) side at each end
+typedef struct {
+	float ux, uy;
+	float ox, oy;
+	point_t l0, r0, l1, r1;
+} stroke_seg_t;
+
+static inline int32_t lcd_roundf(float v)
+{
+	return (int32_t)floorf(v + 0.5f);
+}
+
+// Add the edges of a closed polygon, always with the same winding so the
+// nonzero rule fills the union of all the polygons of a stroke
+static void stroke_poly(edge_t *edges, int32_t *ne, const point_t *p, int32_t n)
+{
+	int64_t area = 0;
+	for (int32_t i = 0, j = n-1; i < n; j = i++) {
+		area += (int64_t)p[j].x * p[i].y - (int64_t)p[i].x * p[j].y;
+	}
+	if (area == 0) return;
+	for (int32_t i = 0, j = n-1; i < n; j = i++) {
+		const point_t *a = (area > 0) ? &p[j] : &p[i];
+		const point_t *b = (area > 0) ? &p[i] : &p[j];
+		if (lcd_edge(&edges[*ne], a->x, a->y, b->x, b->y)) (*ne)++;
+	}
+}
+
+// Set up segment a-b, extended by e0 at the start and e1 at the end.
+// The centerline runs through pixel centers.
+static void stroke_seg(stroke_seg_t *s, const point_t *a, const point_t *b, float h, float e0, float e1)
+{
+	float dx = b->x - a->x, dy = b->y - a->y;
+	float len = sqrtf(dx*dx + dy*dy);
+	s->ux = dx / len;
+	s->uy = dy / len;
+	s->ox = -s->uy * h;
+	s->oy = s->ux * h;
+	float x0 = a->x + 0.5f - s->ux*e0, y0 = a->y + 0.5f - s->uy*e0;
+	float x1 = b->x + 0.5f + s->ux*e1, y1 = b->y + 0.5f + s->uy*e1;
+	s->l0 = (point_t){lcd_roundf(x0 + s->ox), lcd_roundf(y0 + s->oy)};
+	s->r0 = (point_t){lcd_roundf(x0 - s->ox), lcd_roundf(y0 - s->oy)};
+	s->l1 = (point_t){lcd_roundf(x1 + s->ox), lcd_roundf(y1 + s->oy)};
+	s->r1 = (point_t){lcd_roundf(x1 - s->ox), lcd_roundf(y1 - s->oy)};
+}
+
+// Fill the gap on the outside of the turn from segment s to segment t at
+// point c. The polygon also covers the inside, which the nonzero rule
+// merges with the segments, so no pixel of the join is drawn twice.
+static void stroke_join(edge_t *edges, int32_t *ne, const stroke_seg_t *s, const stroke_seg_t *t,
+	const point_t *c, float h, join_t join)
+{
+	float turn = s->ux*t->uy - s->uy*t->ux;
+	if (join == JOIN_NONE || turn == 0.0f) return;
+
+	// outer side is right of the path when turning left, and vice versa
+	point_t so = (turn > 0) ? s->r1 : s->l1, si = (turn > 0) ? s->l1 : s->r1;
+	point_t to = (turn > 0) ? t->r0 : t->l0, ti = (turn > 0) ? t->l0 : t->r0;
+	point_t p[5];
+	int32_t n = 0;
+	p[n++] = so;
+	if (join == JOIN_MITER) {
+		// tip where the outer edges meet, at most 4 half widths out
+		float sx = (turn > 0) ? -s->ox : s->ox, sy = (turn > 0) ? -s->oy : s->oy;
+		float tx = (turn > 0) ? -t->ox : t->ox, ty = (turn > 0) ? -t->oy : t->oy;
+		float k = h*h + sx*tx + sy*ty;
+		if (k * 8.0f > h*h) {
+			k = h*h / k;
+			p[n++] = (point_t){lcd_roundf(c->x + 0.5f + (sx+tx)*k), lcd_roundf(c->y + 0.5f + (sy+ty)*k)};
+		}
+	}
+	p[n++] = to;
+	p[n++] = si;
+	p[n++] = ti;
+	stroke_poly(edges, ne, p, n);
+}
+
+// Draw thick polyline
+// points:vertices, first and last equal for a closed outline
+// n:number of vertices
+// width:line width in pixels
+// join:how segments meet, JOIN_NONE, JOIN_BEVEL or JOIN_MITER
+// color:color
+// Each batch of segments and joins is one polygon fill, so overlapping
+// parts are written once. Open ends are extended by half a pixel so the
+// end points are drawn, like lcdDrawLine.
+void lcdDrawPolyline(TFT_t *dev, const point_t *points, int32_t n, int32_t width, join_t join, uint16_t color)
+{
+	if (n < 2) return;
+	if (width <= 1) {
+		for (int32_t i = 1; i < n; i++) {
+			lcdDrawLine(dev, points[i-1].x, points[i-1].y, points[i].x, points[i].y, color);
+		}
+		return;
+	}
+
+	// repeated points have no direction, they are skipped
+	int32_t np = 1;
+	for (int32_t i = 1; i < n; i++) {
+		if (points[i].x != points[i-1].x || points[i].y != points[i-1].y) np++;
+	}
+	if (np < 2) return;
+	bool closed = (np > 3 && points[0].x == points[n-1].x && points[0].y == points[n-1].y);
+
+	float h = width * 0.5f;
+	edge_t edges[CONFIG_STROKE_BATCH*(4+5)+5]; // quads and joins, and the closing join
+	int32_t ne = 0, nb = 0;
+	stroke_seg_t first, prev, seg;
+	const point_t *a = &points[0];
+	for (int32_t i = 1, k = 1; i < n; i++) {
+		const point_t *b = &points[i];
+		if (b->x == a->x && b->y == a->y) continue;
+		float e0 = (k == 1 && !closed) ? 0.5f : 0.0f;
+		float e1 = (k == np-1 && !closed) ? 0.5f : 0.0f;
+		stroke_seg(&seg, a, b, h, e0, e1);
+		point_t quad[4] = {seg.l0, seg.l1, seg.r1, seg.r0};
+		stroke_poly(edges, &ne, quad, 4);
+		if (k == 1) first = seg;
+		else stroke_join(edges, &ne, &prev, &seg, a, h, join);
+		prev = seg;
+		if (++nb == CONFIG_STROKE_BATCH && k < np-1) { // the last batch waits for the closing join
+			lcd_fill_edges(dev, edges, ne, color);
+			ne = nb = 0;
+		}
+		a = b;
+		k++;
+	}
+	if (closed) stroke_join(edges, &ne, &prev, &first, &points[0], h, join);
+	lcd_fill_edges(dev, edges, ne, color);
 }
 
-// Draw circle of filling
+// Draw thick line
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// width:line width in pixels
+// color:color
+void lcdDrawThickLine(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t width, uint16_t color)
+{
+	point_t p[2] = {{x1, y1}, {x2, y2}};
+	lcdDrawPolyline(dev, p, 2, width, JOIN_NONE, color);
+}
+
+// Draw circle
 // x0:Central X coordinate
 // y0:Central Y coordinate
 // r:radius
 // color:color
-void lcdFillCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color) {
+void lcdDrawCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color) {
+	int32_t x;
+	int32_t y;
+	int32_t err;
+	int32_t old_err;
+
+	x=0;
+	y=-r;
+	err=2-2*r;
+	do{
+		lcdDrawPixel(dev, x0-x, y0+y, color);
+		lcdDrawPixel(dev, x0-y, y0-x, color);
+		lcdDrawPixel(dev, x0+x, y0-y, color);
+		lcdDrawPixel(dev, x0+y, y0+x, color);
+		if ((old_err=err)<=x)	err+=++x*2+1;
+		if (old_err>y || err>x) err+=++y*2+1;
+	} while(y<0);
+}
+
+// Sine of an integer angle in degrees, Q15 (1.0 = 32768)
+static inline int32_t lcd_sin(int32_t deg)
+{
+	deg %= 360;
+	if (deg < 0) deg += 360;
+	if (deg <= 90)  return  sin_q15[deg];
+	if (deg <= 180) return  sin_q15[180-deg];
+	if (deg <= 270) return -sin_q15[deg-180];
+	return -sin_q15[360-deg];
+}
+
+// Cosine of an integer angle in degrees, Q15 (1.0 = 32768)
+static inline int32_t lcd_cos(int32_t deg)
+{
+	return lcd_sin(deg+90);
+}
+
+// Compute the half width of each row of a filled circle, hw[0..r].
+// Uses the same stepping as lcdDrawCircle, so the shape is unchanged:
+// column x first reaches the half height -y.
+static void lcd_circle_widths(int32_t r, uint16_t *hw)
+{
 	int32_t x;
 	int32_t y;
 	int32_t err;
@@ -899,13 +1840,7 @@ void lcdFillCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color
 	ChangeX=1;
 	do{
 		if(ChangeX) {
-#if 1
-			lcdDrawVLine(dev, x0-x, y0+y, (-y<<1)+1, color);
-			lcdDrawVLine(dev, x0+x, y0+y, (-y<<1)+1, color);
-#else
-			lcdDrawLine(dev, x0-x, y0-y, x0-x, y0+y, color);
-			lcdDrawLine(dev, x0+x, y0-y, x0+x, y0+y, color);
-#endif
+			for (int32_t dy = 0; dy <= -y; dy++) hw[dy] = x;
 		} // endif
 		ChangeX=(old_err=err)<=x;
 		if (ChangeX)			err+=++x*2+1;
@@ -913,6 +1848,131 @@ void lcdFillCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color
 	} while(y<=0);
 }
 
+// Return the half widths of the rows of a circle of radius r. Circles up
+// to CIRCLE_TABLE_R come from the generated circle_hw table, which is
+// read only, so any task may draw them.
+// tmp: space for r+1 widths, used when r is too big for the table.
+static const uint16_t *lcd_circle_hw(int32_t r, uint16_t *tmp)
+{
+	if (r > CIRCLE_TABLE_R) {
+		lcd_circle_widths(r, tmp);
+		return tmp;
+	}
+	return circle_hw + r*(r+1)/2;
+}
+
+#define CIRCLE_TMP_LEN(r) (((r) > CIRCLE_TABLE_R) ? (r)+1 : 1)
+
+// Draw circle of filling, each row is one span
+// x0:Central X coordinate
+// y0:Central Y coordinate
+// r:radius
+// color:color
+void lcdFillCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color) {
+	int32_t y1 = y0-r, y2 = y0+r;
+	if (r < 0) return;
+	if (x0+r < 0 || x0-r >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (y1 < 0) y1 = 0; // clip
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+
+	uint16_t tmp[CIRCLE_TMP_LEN(r)];
+	const uint16_t *hw = lcd_circle_hw(r, tmp);
+	for (int32_t y = y1; y <= y2; y++) {
+		int32_t w = hw[abs(y-y0)];
+		lcd_span(dev, y, x0-w, x0+w, color);
+	}
+}
+
+// Draw ring of filling, the area between two circles
+// x0:Central X coordinate
+// y0:Central Y coordinate
+// r1:inner radius, pixels of the inner circle are not drawn
+// r2:outer radius
+// color:color
+void lcdFillRing(TFT_t *dev, int32_t x0, int32_t y0, int32_t r1, int32_t r2, uint16_t color) {
+	int32_t y1 = y0-r2, y2 = y0+r2;
+	if (r1 < 0) {lcdFillCircle(dev, x0, y0, r2, color); return;}
+	if (r1 >= r2) return;
+	if (x0+r2 < 0 || x0-r2 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (y1 < 0) y1 = 0; // clip
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+
+	uint16_t tmp1[CIRCLE_TMP_LEN(r1)], tmp2[CIRCLE_TMP_LEN(r2)];
+	const uint16_t *hi = lcd_circle_hw(r1, tmp1);
+	const uint16_t *ho = lcd_circle_hw(r2, tmp2);
+	for (int32_t y = y1; y <= y2; y++) {
+		int32_t dy = abs(y-y0);
+		int32_t wo = ho[dy];
+		if (dy > r1) {
+			lcd_span(dev, y, x0-wo, x0+wo, color);
+		} else if (hi[dy] < wo) {
+			int32_t wi = hi[dy];
+			lcd_span(dev, y, x0-wo, x0-wi-1, color);
+			lcd_span(dev, y, x0+wi+1, x0+wo, color);
+		}
+	}
+}
+
+// Fill the pixels of span x1..x2 (relative to the center) that are inside
+// the sector between the directions (sc, ss) and (ec, es).
+static void lcd_arc_span(TFT_t *dev, int32_t x0, int32_t y, int32_t dy, int32_t x1, int32_t x2,
+	int32_t sc, int32_t ss, int32_t ec, int32_t es, bool wide, uint16_t color)
+{
+	int32_t run = 0;
+	for (int32_t dx = x1; dx <= x2; dx++) {
+		bool in_s = sc*dy - ss*dx >= 0; // clockwise from start
+		bool in_e = ec*dy - es*dx <= 0; // counter-clockwise from end
+		if (wide ? (in_s || in_e) : (in_s && in_e)) {
+			run++;
+		} else if (run) {
+			lcd_span(dev, y, x0+dx-run, x0+dx-1, color);
+			run = 0;
+		}
+	}
+	if (run) lcd_span(dev, y, x0+x2-run+1, x0+x2, color);
+}
+
+// Draw arc of filling, the part of a ring between two angles
+// x0:Central X coordinate
+// y0:Central Y coordinate
+// r1:inner radius, -1 for a pie slice
+// r2:outer radius
+// start:start angle in degrees, clockwise from the +X axis
+// end:end angle in degrees, clockwise from start
+// color:color
+void lcdFillArc(TFT_t *dev, int32_t x0, int32_t y0, int32_t r1, int32_t r2, int32_t start, int32_t end, uint16_t color) {
+	int32_t sweep = end - start;
+	if (sweep >= 360 || sweep <= -360) {lcdFillRing(dev, x0, y0, r1, r2, color); return;}
+	sweep = (sweep + 360) % 360;
+	if (sweep == 0 || r1 >= r2 || r2 < 0) return;
+
+	int32_t y1 = y0-r2, y2 = y0+r2;
+	if (x0+r2 < 0 || x0-r2 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (y1 < 0) y1 = 0; // clip
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+
+	int32_t sc = lcd_cos(start), ss = lcd_sin(start);
+	int32_t ec = lcd_cos(end), es = lcd_sin(end);
+	bool wide = sweep > 180;
+	uint16_t tmp1[CIRCLE_TMP_LEN(r1)], tmp2[CIRCLE_TMP_LEN(r2)];
+	const uint16_t *hi = (r1 < 0) ? NULL : lcd_circle_hw(r1, tmp1);
+	const uint16_t *ho = lcd_circle_hw(r2, tmp2);
+	for (int32_t y = y1; y <= y2; y++) {
+		int32_t dy = y-y0;
+		int32_t wo = ho[abs(dy)];
+		if (hi == NULL || abs(dy) > r1) {
+			lcd_arc_span(dev, x0, y, dy, -wo, wo, sc, ss, ec, es, wide, color);
+		} else if (hi[abs(dy)] < wo) {
+			int32_t wi = hi[abs(dy)];
+			lcd_arc_span(dev, x0, y, dy, -wo, -wi-1, sc, ss, ec, es, wide, color);
+			lcd_arc_span(dev, x0, y, dy, wi+1, wo, sc, ss, ec, es, wide, color);
+		}
+	}
+}
+
 // Draw rectangle with round corner
 // x1:Start X coordinate
 // y1:Start Y coordinate
@@ -1018,20 +2078,31 @@ void lcdFillArrow(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, in
 	R[1]= y1 - Ux*w - Uy*v;
 	//printf("L=%ld-%ld R=%ld-%ld\n",L[0],L[1],R[0],R[1]);
 
+	point_t head[3] = {{x1, y1}, {L[0], L[1]}, {R[0], R[1]}};
+	lcdFillPolygon(dev, head, 3, color);
+
 	lcdDrawLine(dev, x0, y0, x1, y1, color);
 	lcdDrawLine(dev, x1, y1, L[0], L[1], color);
 	lcdDrawLine(dev, x1, y1, R[0], R[1], color);
 	lcdDrawLine(dev, L[0], L[1], R[0], R[1], color);
+}
 
-	int32_t ww;
-	for(ww=w-1;ww>0;ww--) {
-		L[0]= x1 - Uy*ww - Ux*v;
-		L[1]= y1 + Ux*ww - Uy*v;
-		R[0]= x1 + Uy*ww - Ux*v;
-		R[1]= y1 - Ux*ww - Uy*v;
-		//printf("Fill>L=%ld-%ld R=%ld-%ld\n",L[0],L[1],R[0],R[1]);
-		lcdDrawLine(dev, x1, y1, L[0], L[1], color);
-		lcdDrawLine(dev, x1, y1, R[0], R[1], color);
+// Rotate points about the origin by angle and translate them to (xc, yc).
+// The sine and cosine are looked up once for all the points.
+// When the origin is (0, 0), the point (x1, y1) after rotating the point (x, y)
+// by the angle is obtained by the following calculation.
+// x1 = x * cos(-angle) - y * sin(-angle)
+// y1 = x * sin(-angle) + y * cos(-angle)
+// The Q15 products are floored, where the float casts truncated toward
+// zero, so a vertex can land one pixel away from the float version.
+static void lcd_rotate(point_t *p, int32_t n, int32_t xc, int32_t yc, int32_t angle)
+{
+	int32_t c = lcd_cos(angle);
+	int32_t s = lcd_sin(angle);
+	for (int32_t i = 0; i < n; i++) {
+		int32_t x = p[i].x, y = p[i].y;
+		p[i].x = xc + ((x*c + y*s) >> 15);
+		p[i].y = yc + ((y*c - x*s) >> 15);
 	}
 }
 
@@ -1042,40 +2113,14 @@ void lcdFillArrow(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, in
 // h:Height of rectangle
 // angle:Angle of rectangle
 // color:color
-
-// When the origin is (0, 0), the point (x1, y1) after rotating the point (x, y)
-// by the angle is obtained by the following calculation.
-// x1 = x * cos(angle) - y * sin(angle)
-// y1 = x * sin(angle) + y * cos(angle)
 void lcdDrawRectangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color) {
-	float xd, yd, rd;
-	int32_t x1, y1;
-	int32_t x2, y2;
-	int32_t x3, y3;
-	int32_t x4, y4;
-	rd = -angle * M_PIf / 180.0f;
-	xd = 0.0f - w/2;
-	yd = h/2;
-	x1 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	yd = 0.0f - yd;
-	x2 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	point_t p[4] = {{-w/2, h/2}, {-w/2, -h/2}, {w/2, h/2}, {w/2, -h/2}};
+	lcd_rotate(p, 4, xc, yc, angle);
 
-	xd = w/2;
-	yd = h/2;
-	x3 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	yd = 0.0f - yd;
-	x4 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y4 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	lcdDrawLine(dev, x1, y1, x2, y2, color);
-	lcdDrawLine(dev, x1, y1, x3, y3, color);
-	lcdDrawLine(dev, x2, y2, x4, y4, color);
-	lcdDrawLine(dev, x3, y3, x4, y4, color);
+	lcdDrawLine(dev, p[0].x, p[0].y, p[1].x, p[1].y, color);
+	lcdDrawLine(dev, p[0].x, p[0].y, p[2].x, p[2].y, color);
+	lcdDrawLine(dev, p[1].x, p[1].y, p[3].x, p[3].y, color);
+	lcdDrawLine(dev, p[2].x, p[2].y, p[3].x, p[3].y, color);
 }
 
 // Draw triangle
@@ -1085,34 +2130,13 @@ void lcdDrawRectangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h,
 // h:Height of triangle
 // angle:Angle of triangle
 // color:color
-
-// When the origin is (0, 0), the point (x1, y1) after rotating the point (x, y)
-// by the angle is obtained by the following calculation.
-// x1 = x * cos(angle) - y * sin(angle)
-// y1 = x * sin(angle) + y * cos(angle)
 void lcdDrawTriangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color) {
-	float xd, yd, rd;
-	int32_t x1, y1;
-	int32_t x2, y2;
-	int32_t x3, y3;
-	rd = -angle * M_PIf / 180.0f;
-	xd = 0.0f;
-	yd = h/2;
-	x1 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	xd = w/2;
-	yd = 0.0f - yd;
-	x2 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	point_t p[3] = {{0, h/2}, {w/2, -h/2}, {-w/2, -h/2}};
+	lcd_rotate(p, 3, xc, yc, angle);
 
-	xd = 0.0f - w/2;
-	x3 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	lcdDrawLine(dev, x1, y1, x2, y2, color);
-	lcdDrawLine(dev, x1, y1, x3, y3, color);
-	lcdDrawLine(dev, x2, y2, x3, y3, color);
+	lcdDrawLine(dev, p[0].x, p[0].y, p[1].x, p[1].y, color);
+	lcdDrawLine(dev, p[0].x, p[0].y, p[2].x, p[2].y, color);
+	lcdDrawLine(dev, p[1].x, p[1].y, p[2].x, p[2].y, color);
 }
 
 // Draw regular polygon
@@ -1124,33 +2148,144 @@ void lcdDrawTriangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, i
 // color:color
 void lcdDrawRegularPolygon(TFT_t *dev, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color)
 {
-	float xd, yd, rd;
 	int32_t x1, y1;
 	int32_t x2, y2;
-	int32_t i;
 
-	rd = -angle * M_PIf / 180.0f;
-	for (i = 0; i < n; i++)	{
-		xd = r * cosf(2 * M_PIf * i / n);
-		yd = r * sinf(2 * M_PIf * i / n);
-		x1 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y1 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	if (n < 1) return;
+	// vertex i is at (360*i/n - angle) degrees, rounded to a whole degree
+	x1 = xc + ((r * lcd_cos(-angle)) >> 15);
+	y1 = yc + ((r * lcd_sin(-angle)) >> 15);
+	for (int32_t i = 1; i <= n; i++) {
+		int32_t deg = (360*i + n/2) / n - angle;
+		x2 = xc + ((r * lcd_cos(deg)) >> 15);
+		y2 = yc + ((r * lcd_sin(deg)) >> 15);
+		lcdDrawLine(dev, x1, y1, x2, y2, color);
+		x1 = x2; y1 = y2;
+	}
+}
 
-		xd = r * cosf(2 * M_PIf * (i + 1) / n);
-		yd = r * sinf(2 * M_PIf * (i + 1) / n);
-		x2 = (int32_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y2 = (int32_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+// Draw rectangle of filling with angle
+// xc:Center X coordinate
+// yc:Center Y coordinate
+// w:Width of rectangle
+// h:Height of rectangle
+// angle:Angle of rectangle
+// color:color
+void lcdFillRectangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color) {
+	point_t p[4] = {{-w/2, h/2}, {-w/2, -h/2}, {w/2, -h/2}, {w/2, h/2}};
+	lcd_rotate(p, 4, xc, yc, angle);
+	lcdFillPolygon(dev, p, 4, color);
+}
 
-		lcdDrawLine(dev, x1, y1, x2, y2, color);
+// Draw regular polygon of filling
+// xc:Center X coordinate
+// yc:Center Y coordinate
+// n:Number of slides
+// r:radius
+// angle:Angle of regular polygon
+// color:color
+void lcdFillRegularPolygon(TFT_t *dev, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color)
+{
+	if (n < 3) return;
+	point_t p[n];
+	for (int32_t i = 0; i < n; i++) {
+		int32_t deg = (360*i + n/2) / n - angle;
+		p[i].x = xc + ((r * lcd_cos(deg)) >> 15);
+		p[i].y = yc + ((r * lcd_sin(deg)) >> 15);
+	}
+	lcdFillPolygon(dev, p, n, color);
+}
+
+// Rasterize one pixel row of a string with background into colors[].
+// ascii: string, py: pixel row within the string (0 to LCD_CHAR_H*size-1)
+// px1,px2: first and last pixel column within the string to output
+// glyphs: font, size: font size
+// color,back: foreground and background colors, stored as given
+static void lcd_raster_string_row(const char *ascii, const uint8_t *glyphs, uint8_t size, int32_t py, int32_t px1, int32_t px2, uint16_t color, uint16_t back, uint16_t *colors)
+{
+	int32_t cw = LCD_CHAR_W*size;
+	uint8_t mask = 1 << (py / size);
+	int32_t c = px1 / cw;          // character index
+	int32_t i = (px1 % cw) / size; // glyph column
+	int32_t s = px1 % size;        // pixel within a scaled glyph column
+
+	for (int32_t px = px1; px <= px2; ) {
+		uint8_t line = (i == LCD_CHAR_W-1) ? 0x0 : glyphs[((uint8_t)ascii[c] * (LCD_CHAR_W-1)) + i];
+		uint16_t pc = (line & mask) ? color : back;
+		for (; s < size && px <= px2; s++, px++) *colors++ = pc;
+		s = 0;
+		if (++i == LCD_CHAR_W) {i = 0; c++;}
 	}
 }
 
+// Draw a string with background one pixel row at a time, in the font
+// direction. In frame buffer mode, unrotated rows are rasterized in place
+// and rotated ones are stored with a stride. In direct mode, the whole
+// string is sent as one window with the rows staged (swapped) in the SPI
+// buffer; rotated windows change the controller scan order instead.
+static void lcd_draw_string_rows(TFT_t *dev, int32_t x, int32_t y, const char *ascii, int32_t length, uint16_t color, uint16_t back)
+{
+	direction_t dir = dev->_font_direction;
+	rect_t t, r; // visible part, string (u, v) and screen
+	if (!lcd_dir_clip(dev, dir, x, y, length*LCD_CHAR_W*dev->_font_size, LCD_CHAR_H*dev->_font_size, &t, &r)) return;
+
+	if (dev->_use_frame_buffer) {
+		int32_t n = t.x2-t.x1+1, step = lcd_dir_step(dev, dir);
+		uint16_t row[(dir == DIRECTION0) ? 1 : n];
+		for (int32_t v = t.y1; v <= t.y2; v++) {
+			int32_t px, py;
+			lcd_dir_map(dir, x, y, t.x1, v, &px, &py);
+			uint16_t *dst = dev->_frame_buffer + py*dev->_width + px;
+			if (dir == DIRECTION0) {
+				lcd_raster_string_row(ascii, dev->_font, dev->_font_size, v, t.x1, t.x2, color, back, dst);
+				continue;
+			}
+			lcd_raster_string_row(ascii, dev->_font, dev->_font_size, v, t.x1, t.x2, color, back, row);
+			for (int32_t k = 0; k < n; k++, dst += step) *dst = row[k];
+		}
+	} else {
+		uint16_t sc = SWAP16(color), sb = SWAP16(back);
+		size_t len = 0;
+		lcd_set_window_dir(dev, dir, &r);
+		spi_master_dc(dev, SPI_Data_Mode);
+		for (int32_t v = t.y1; v <= t.y2; v++) {
+			// a row may be split across staging buffer boundaries
+			for (int32_t u = t.x1; u <= t.x2; ) {
+				int32_t n = t.x2 - u + 1;
+				if (n > BUF_LEN - len) n = BUF_LEN - len;
+				lcd_raster_string_row(ascii, dev->_font, dev->_font_size, v, u, u+n-1, sc, sb, dev->_buffer+len);
+				u += n; len += n;
+				if (len == BUF_LEN) {
+					spi_master_write_bytes(dev, (uint8_t *)dev->_buffer, len*sizeof(uint16_t));
+					len = 0;
+				}
+			}
+		}
+		if (len) spi_master_write_bytes(dev, (uint8_t *)dev->_buffer, len*sizeof(uint16_t));
+		lcd_madctl_restore(dev, dir);
+	}
+}
+
+// Screen coordinate along the text line after n characters from (x, y),
+// the X coordinate for 0 and 180 degrees and the Y coordinate otherwise
+static int32_t lcd_text_advance(TFT_t *dev, int32_t x, int32_t y, int32_t n)
+{
+	int32_t px, py;
+	lcd_dir_map(dev->_font_direction, x, y, n*LCD_CHAR_W*dev->_font_size, 0, &px, &py);
+	return (dev->_font_direction == DIRECTION0 || dev->_font_direction == DIRECTION180) ? px : py;
+}
+
 // Draw ASCII character
 // x:X coordinate
 // y:Y coordinate
 // ascii: ascii code
 // color:color
 int32_t lcdDrawChar(TFT_t *dev, int32_t x, int32_t y, char ascii, uint16_t color) {
+  if (dev->_font == NULL) return lcd_text_advance(dev, x, y, 1); // no font set
+  if (dev->_font_back_en) { // opaque, draw background and glyph in one pass
+    lcd_draw_string_rows(dev, x, y, &ascii, 1, color, dev->_font_back_color);
+    return lcd_text_advance(dev, x, y, 1);
+  }
 #if 0
   if ((x >= dev->_width) ||                        // off screen right
       (y >= dev->_height) ||                       // off screen bottom
@@ -1159,25 +2294,23 @@ int32_t lcdDrawChar(TFT_t *dev, int32_t x, int32_t y, char ascii, uint16_t color
     return;
 #endif
 
-  if (dev->_font_back_en) {
-    lcdFillRect(dev, x, y,
-      x+LCD_CHAR_W*dev->_font_size-1,
-      y+LCD_CHAR_H*dev->_font_size-1,
-      dev->_font_back_color);
-  }
   for (int8_t i = 0; i < LCD_CHAR_W; i++) {
     uint8_t line;
     if (i == LCD_CHAR_W-1)
       line = 0x0;
     else
-      line = font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
+      line = dev->_font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
     for (int8_t j = 0; j < LCD_CHAR_H; j++) {
       if (line & 0x1) {
-        if (dev->_font_size == 1) // default size
-          lcdDrawPixel(dev, x + i, y + j, color);
+        int32_t s = dev->_font_size, x1, y1, x2, y2; // block of the glyph pixel, turned
+        lcd_dir_map(dev->_font_direction, x, y, i*s, j*s, &x1, &y1);
+        if (s == 1) // default size
+          lcdDrawPixel(dev, x1, y1, color);
         else { // big size
-          int32_t x1 = x + (i * dev->_font_size), y1 = y + (j * dev->_font_size);		
-          lcdFillRect(dev, x1, y1, x1+dev->_font_size-1, y1+dev->_font_size-1, color);
+          lcd_dir_map(dev->_font_direction, x, y, i*s+s-1, j*s+s-1, &x2, &y2);
+          if (x1 > x2) swap(int32_t, x1, x2);
+          if (y1 > y2) swap(int32_t, y1, y2);
+          lcdFillRect(dev, x1, y1, x2, y2, color);
         }
       }
 #if 0
@@ -1193,23 +2326,284 @@ int32_t lcdDrawChar(TFT_t *dev, int32_t x, int32_t y, char ascii, uint16_t color
       line >>= 1;
     }
   }
-  return x+LCD_CHAR_W*dev->_font_size;
+  return lcd_text_advance(dev, x, y, 1);
 }
 
-// Draw ASCII string
-// x:X coordinate
+// Draw ASCII string in the font direction
+// x:X coordinate of the top left of the first character, before turning
 // y:Y coordinate
 // ascii: ascii string, zero terminated
 // color:color
+// Return the coordinate along the line after the string, X for 0 and 180
+// degrees and Y for 90 and 270.
 int32_t lcdDrawString(TFT_t *dev, int32_t x, int32_t y, char *ascii, uint16_t color) {
 	int32_t length = strlen(ascii);
+	if (dev->_font == NULL) return lcd_text_advance(dev, x, y, length); // no font set
+	if (dev->_font_back_en) { // opaque, rasterize the whole string by rows
+		lcd_draw_string_rows(dev, x, y, ascii, length, color, dev->_font_back_color);
+		return lcd_text_advance(dev, x, y, length);
+	}
 	for (int32_t i=0; i<length; i++) {
-		x = lcdDrawChar(dev, x, y, ascii[i], color);
+		int32_t cx, cy;
+		lcd_dir_map(dev->_font_direction, x, y, i*LCD_CHAR_W*dev->_font_size, 0, &cx, &cy);
+		lcdDrawChar(dev, cx, cy, ascii[i], color);
+	}
+	return lcd_text_advance(dev, x, y, length);
+}
+
+// Create a text label. The label is a cached block of rasterized text,
+// sized for max_len characters at the current font size.
+// x:X coordinate
+// y:Y coordinate
+// max_len:maximum number of characters
+// Return true if successful, otherwise false.
+bool lcdLabelCreate(TFT_t *dev, label_t *label, int32_t x, int32_t y, int32_t max_len) {
+	label->_x = x;
+	label->_y = y;
+	label->_width = max_len*LCD_CHAR_W*dev->_font_size;
+	label->_height = LCD_CHAR_H*dev->_font_size;
+	label->_max_len = max_len;
+	label->_font_size = dev->_font_size;
+	label->_font = dev->_font;
+	label->_color = 0;
+	label->_back_color = 0;
+	label->_text = heap_caps_calloc(max_len+1, sizeof(char), MALLOC_CAP_8BIT);
+	label->_pixels = heap_caps_malloc(sizeof(uint16_t)*label->_width*label->_height, MALLOC_CAP_DMA);
+	if (label->_text == NULL || label->_pixels == NULL) {
+		ESP_LOGE(TAG, "heap_caps_malloc fail");
+		lcdLabelDelete(label);
+		return false;
+	}
+	memset(label->_pixels, 0, sizeof(uint16_t)*label->_width*label->_height); // empty, black
+	label->_changed = true;
+	return true;
+}
+
+// Set the text of a label. The text is rasterized into the label only
+// when the string or colors differ from what the label already holds.
+// ascii: ascii string, zero terminated, truncated to max_len
+// color:color
+// back_color:background color
+// Return true if the label changed, otherwise false.
+bool lcdLabelSet(label_t *label, const char *ascii, uint16_t color, uint16_t back_color) {
+	if (label->_pixels == NULL || label->_font == NULL) return false;
+	if (color == label->_color && back_color == label->_back_color &&
+		strncmp(label->_text, ascii, label->_max_len) == 0) return false;
+
+	strncpy(label->_text, ascii, label->_max_len);
+	label->_color = color;
+	label->_back_color = back_color;
+
+	// pad with spaces, so the background covers the previous text
+	char text[label->_max_len+1];
+	int32_t length = strlen(label->_text);
+	memcpy(text, label->_text, length);
+	memset(text+length, ' ', label->_max_len-length);
+	text[label->_max_len] = '\0';
+	for (int32_t j = 0; j < label->_height; j++) {
+		lcd_raster_string_row(text, label->_font, label->_font_size, j, 0, label->_width-1,
+			color, back_color, label->_pixels + j*label->_width);
+	}
+	label->_changed = true;
+	return true;
+}
+
+// Draw a label. The cached pixels are copied to the screen by rows, also
+// over a cleared frame. In frame buffer mode the label is marked dirty for
+// lcdWriteDirty only when it changed since it was last drawn.
+void lcdLabelDraw(TFT_t *dev, label_t *label) {
+	if (label->_pixels == NULL) return;
+	lcdDrawBitmap(dev, label->_x, label->_y, label->_width, label->_height, label->_pixels, label->_width);
+	if (dev->_use_frame_buffer && label->_changed) {
+		lcdDirtyAdd(dev, label->_x, label->_y, label->_x+label->_width-1, label->_y+label->_height-1);
+	}
+	label->_changed = false;
+}
+
+// Free resources used by a label
+void lcdLabelDelete(label_t *label) {
+	if (label->_text != NULL) heap_caps_free(label->_text);
+	if (label->_pixels != NULL) heap_caps_free(label->_pixels);
+	label->_text = NULL;
+	label->_pixels = NULL;
+}
+
+// Set a transform that scales and rotates a surface about its center
+// m:transform to set
+// src:source surface
+// xc:X coordinate of the center on screen
+// yc:Y coordinate of the center on screen
+// scale:16.16 fixed point scale, 65536 is 1x
+// angle:rotation in degrees, same direction as lcdDrawRectangle
+void lcdAffineRotateScale(affine_t *m, const surface_t *src, int32_t xc, int32_t yc, int32_t scale, int32_t angle)
+{
+	int32_t c = lcd_cos(angle), s = lcd_sin(angle); // Q15
+	m->a = ((int64_t)c * scale) >> 15;
+	m->b = ((int64_t)s * scale) >> 15;
+	m->c = -m->b;
+	m->d = m->a;
+	// source center (w/2, h/2) maps to (xc, yc)
+	int64_t hw = (int64_t)src->width * 32768, hh = (int64_t)src->height * 32768;
+	m->tx = (int64_t)xc * 65536 - ((m->a * hw + m->b * hh) >> 16);
+	m->ty = (int64_t)yc * 65536 - ((m->c * hw + m->d * hh) >> 16);
+}
+
+// floor(a/b) and ceil(a/b) for b > 0
+static inline int64_t div_floor(int64_t a, int64_t b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int64_t div_ceil(int64_t a, int64_t b)
+{
+	return -div_floor(-a, b);
+}
+
+// Narrow [*x1,*x2] to the x where 0 <= p0 + x*dp < lim
+static void affine_clip(int64_t p0, int32_t dp, int64_t lim, int32_t *x1, int32_t *x2)
+{
+	int64_t lo, hi;
+	if (dp == 0) {
+		if (p0 < 0 || p0 >= lim) *x2 = *x1 - 1;
+		return;
+	} else if (dp > 0) {
+		lo = div_ceil(-p0, dp);
+		hi = div_floor(lim - 1 - p0, dp);
+	} else {
+		lo = div_ceil(p0 - (lim - 1), -dp);
+		hi = div_floor(p0, -dp);
+	}
+	if (lo > *x1) *x1 = (lo > *x2) ? *x2 + 1 : lo;
+	if (hi < *x2) *x2 = (hi < *x1) ? *x1 - 1 : hi;
+}
+
+// Draw an integer upscaled surface, each source row is expanded once and
+// the result is duplicated for the remaining scale-1 rows
+// x:X coordinate of top left
+// y:Y coordinate of top left
+// src:source surface
+// scale:integer scale, 1 or more
+void lcdDrawSurfaceScaled(TFT_t *dev, const surface_t *src, int32_t x, int32_t y, int32_t scale)
+{
+	if (scale < 1) return;
+	int32_t x1 = x, x2 = x + src->width*scale - 1;
+	int32_t y1 = y, y2 = y + src->height*scale - 1;
+	if (x2 < 0 || x1 >= dev->_width) return; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+	int32_t n = x2-x1+1;
+
+	uint16_t row[dev->_use_frame_buffer ? 1 : n];
+	if (!dev->_use_frame_buffer) lcd_set_window(dev, x1, y1, x2, y2);
+
+	for (int32_t j = y1; j <= y2; ) {
+		int32_t sy = (j - y) / scale;
+		int32_t last = y + (sy+1)*scale - 1; // last screen row of source row sy
+		if (last > y2) last = y2;
+		const uint16_t *sp = src->pixels + sy*src->stride;
+		uint16_t *dst = dev->_use_frame_buffer ? dev->_frame_buffer + j*dev->_width + x1 : row;
+
+		// expand the source row, starting part way into a source pixel
+		int32_t sx = (x1 - x) / scale;
+		int32_t rep = scale - (x1 - x) % scale;
+		for (int32_t i = 0; i < n; ) {
+			uint16_t color = sp[sx++];
+			for (; rep > 0 && i < n; rep--) dst[i++] = color;
+			rep = scale;
+		}
+
+		if (dev->_use_frame_buffer) {
+			for (int32_t k = j+1; k <= last; k++) {
+				memcpy(dev->_frame_buffer + k*dev->_width + x1, dst, n*sizeof(uint16_t));
+			}
+		} else {
+			for (int32_t k = j; k <= last; k++) spi_master_write_colors(dev, row, n);
+		}
+		j = last + 1;
 	}
-	return x;
 }
 
-// Set font direction
+// Draw a surface through an affine transform with nearest neighbor sampling.
+// Each screen row is mapped back to the source once; the span that lands
+// inside the source is solved up front, so the inner loop only steps.
+// src:source surface
+// m:transform from source to screen coordinates
+// key:transparent color, or -1 to draw every pixel
+void lcdDrawSurfaceAffine(TFT_t *dev, const surface_t *src, const affine_t *m, int32_t key)
+{
+	// Pure integer upscale, use row duplication
+	if (key < 0 && m->b == 0 && m->c == 0 && m->a == m->d && m->a >= 65536 && (m->a & 0xFFFF) == 0 &&
+		(m->tx & 0xFFFF) == 0 && (m->ty & 0xFFFF) == 0) {
+		lcdDrawSurfaceScaled(dev, src, m->tx >> 16, m->ty >> 16, m->a >> 16);
+		return;
+	}
+
+	int64_t det = (int64_t)m->a * m->d - (int64_t)m->b * m->c; // 32.32
+	if (det == 0) return;
+	// inverse transform, 16.16
+	const int64_t one = (int64_t)1 << 32;
+	int32_t ia = m->d * one / det, ib = -m->b * one / det;
+	int32_t ic = -m->c * one / det, id = m->a * one / det;
+
+	// screen bounding box of the transformed source corners
+	int32_t xmin = INT32_MAX, xmax = INT32_MIN, ymin = INT32_MAX, ymax = INT32_MIN;
+	for (int32_t k = 0; k < 4; k++) {
+		int64_t u = (k & 1) ? src->width : 0, v = (k & 2) ? src->height : 0;
+		int32_t px = (m->a * u + m->b * v + m->tx) >> 16;
+		int32_t py = (m->c * u + m->d * v + m->ty) >> 16;
+		if (px < xmin) xmin = px;
+		if (px > xmax) xmax = px;
+		if (py < ymin) ymin = py;
+		if (py > ymax) ymax = py;
+	}
+	if (xmax < 0 || xmin >= dev->_width) return; // off screen
+	if (ymax < 0 || ymin >= dev->_height) return;
+	if (xmin < 0) xmin = 0; // clip
+	if (xmax >= dev->_width) xmax = dev->_width-1;
+	if (ymin < 0) ymin = 0;
+	if (ymax >= dev->_height) ymax = dev->_height-1;
+
+	int64_t ulim = (int64_t)src->width << 16, vlim = (int64_t)src->height << 16;
+	uint16_t row[dev->_use_frame_buffer ? 1 : xmax-xmin+1];
+	for (int32_t j = ymin; j <= ymax; j++) {
+		// source position of pixel center (0.5, j+0.5)
+		int64_t dx = 0x8000 - m->tx, dy = (int64_t)j * 65536 + 0x8000 - m->ty;
+		int64_t u0 = (ia * dx + ib * dy) >> 16;
+		int64_t v0 = (ic * dx + id * dy) >> 16;
+		int32_t x1 = xmin, x2 = xmax;
+		affine_clip(u0, ia, ulim, &x1, &x2);
+		affine_clip(v0, ic, vlim, &x1, &x2);
+		if (x1 > x2) continue;
+
+		int32_t u = u0 + (int64_t)x1 * ia, v = v0 + (int64_t)x1 * ic;
+		if (dev->_use_frame_buffer) {
+			uint16_t *dst = dev->_frame_buffer + j*dev->_width;
+			for (int32_t i = x1; i <= x2; i++, u += ia, v += ic) {
+				uint16_t color = src->pixels[(v >> 16)*src->stride + (u >> 16)];
+				if (color != key) dst[i] = color;
+			}
+			continue;
+		}
+
+		// direct mode, sample the row then send the runs between transparent pixels
+		int32_t n = x2-x1+1;
+		for (int32_t i = 0; i < n; i++, u += ia, v += ic) {
+			row[i] = src->pixels[(v >> 16)*src->stride + (u >> 16)];
+		}
+		for (int32_t i = 0; i < n; ) {
+			if (row[i] == key) {i++; continue;}
+			int32_t k = i;
+			while (k < n && row[k] != key) k++;
+			lcdDrawBitmap(dev, x1+i, j, k-i, 1, row+i, k-i);
+			i = k;
+		}
+	}
+}
+
+// Set font direction, text is turned clockwise about its start point
 // dir:Direction
 void lcdSetFontDirection(TFT_t *dev, direction_t dir) {
 	dev->_font_direction = dir;
@@ -1233,7 +2627,13 @@ void lcdNoFontBackground(TFT_t *dev) {
 	dev->_font_back_en = false;
 }
 
-// Set display SPI clock
+// Set font glyphs, read in place, e.g. from the asset bundle
+// font:LCD_CHAR_W-1 bytes per character, one byte per column, as glcdfont.c
+void lcdSetFont(TFT_t *dev, const uint8_t *font) {
+	dev->_font = font;
+}
+
+// Set display SPI clock of devices initialized later by lcdInit
 void lcdSPIClockSpeed(int32_t speed) {
     ESP_LOGI(TAG, "SPI clock speed=%d MHz", (int)speed/1000000);
     clock_speed_hz = speed;
@@ -1273,6 +2673,42 @@ void lcdInversionOn(TFT_t *dev) {
 	spi_master_write_command(dev, 0x21); // Display Inversion On
 }
 
+// Partial display mode, only rows y1 to y2 are refreshed by the panel and
+// the rest shows as black. Frame buffer flushes then send only these rows.
+// Same commands on the ILI9341 and ST7789. The rows are panel rows, equal
+// to screen rows while MADCTL does not exchange rows and columns.
+// y1:Start Y coordinate
+// y2:End Y coordinate
+void lcdPartialOn(TFT_t *dev, int32_t y1, int32_t y2) {
+	if (y1 < 0) y1 = 0; // clip
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+	if (y1 > y2) return;
+	dev->_active_y1 = y1;
+	dev->_active_y2 = y2;
+	spi_master_write_command(dev, 0x30); // ILI:Partial Area (30h), ST:PTLAR (30h): Partial Area
+	spi_master_write_addr(dev, y1 + dev->_offsety, y2 + dev->_offsety);
+	spi_master_write_command(dev, 0x12); // ILI:Partial Mode ON (12h), ST:PTLON (12h): Partial Display Mode On
+}
+
+// Back to normal display mode. Rows drawn in the frame buffer outside the
+// partial area were not sent, so the whole frame is written.
+void lcdPartialOff(TFT_t *dev) {
+	dev->_active_y1 = 0;
+	dev->_active_y2 = dev->_height-1;
+	spi_master_write_command(dev, 0x13); // ILI:Normal Display Mode ON (13h), ST:NORON (13h): Normal Display Mode On
+	lcdWriteFrame(dev);
+}
+
+// Idle mode, 8 colors (the top bit of each channel), lower power
+void lcdIdleOn(TFT_t *dev) {
+	spi_master_write_command(dev, 0x39); // ILI:Idle Mode ON (39h), ST:IDMON (39h): Idle Mode On
+}
+
+// Idle mode off, full colors
+void lcdIdleOff(TFT_t *dev) {
+	spi_master_write_command(dev, 0x38); // ILI:Idle Mode OFF (38h), ST:IDMOFF (38h): Idle Mode Off
+}
+
 // Enable use of frame buffer
 void lcdFrameEnable(TFT_t *dev) {
 	dev->_frame_buffer = heap_caps_malloc(sizeof(uint16_t)*dev->_width*dev->_height, MALLOC_CAP_DMA);
@@ -1290,57 +2726,108 @@ void lcdFrameDisable(TFT_t *dev) {
 	dev->_use_frame_buffer = false;
 }
 
-// Scroll image in frame buffer
+// Copy a region of the frame buffer, source and destination may overlap
+// src:region to copy
+// dx:X offset of the destination
+// dy:Y offset of the destination
+void lcdCopyRect(TFT_t *dev, const rect_t *src, int32_t dx, int32_t dy) {
+	if (dev->_use_frame_buffer == false) return;
+
+	int32_t _width = dev->_width;
+	int32_t _height = dev->_height;
+	int32_t x1 = src->x1, y1 = src->y1;
+	int32_t x2 = src->x2, y2 = src->y2;
+	// clip the source, then the destination
+	if (x1 < 0) x1 = 0;
+	if (x2 >= _width) x2 = _width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= _height) y2 = _height-1;
+	if (x1+dx < 0) x1 = -dx;
+	if (x2+dx >= _width) x2 = _width-1-dx;
+	if (y1+dy < 0) y1 = -dy;
+	if (y2+dy >= _height) y2 = _height-1-dy;
+	if (x1 > x2 || y1 > y2) return;
+
+	size_t size = (x2-x1+1)*sizeof(uint16_t);
+	uint16_t *from = &dev->_frame_buffer[y1*_width+x1];
+	uint16_t *to = from + dy*_width + dx;
+	if (dy > 0) {
+		// moving down, copy the bottom row first
+		int32_t last = (y2-y1)*_width;
+		for (int32_t j = y2; j >= y1; j--, last -= _width) memmove(to+last, from+last, size);
+	} else {
+		for (int32_t j = y1; j <= y2; j++, from += _width, to += _width) memmove(to, from, size);
+	}
+}
+
+// Scroll the contents of a region of the frame buffer
+// rect:region to scroll, contents outside it are not touched
+// dx:X offset, positive to the right
+// dy:Y offset, positive down
+// fill:color of the uncovered part of the region
+void lcdScrollRect(TFT_t *dev, const rect_t *rect, int32_t dx, int32_t dy, uint16_t fill) {
+	if (dev->_use_frame_buffer == false) return;
+
+	rect_t r = *rect;
+	if (r.x2 < 0 || r.x1 >= dev->_width) return; // off screen
+	if (r.y2 < 0 || r.y1 >= dev->_height) return;
+	if (r.x1 < 0) r.x1 = 0; // clip
+	if (r.x2 >= dev->_width) r.x2 = dev->_width-1;
+	if (r.y1 < 0) r.y1 = 0;
+	if (r.y2 >= dev->_height) r.y2 = dev->_height-1;
+
+	// part of the region that stays inside it after the move
+	rect_t src = {
+		(dx > 0) ? r.x1 : r.x1-dx, (dy > 0) ? r.y1 : r.y1-dy,
+		(dx > 0) ? r.x2-dx : r.x2, (dy > 0) ? r.y2-dy : r.y2
+	};
+	if (src.x1 > src.x2 || src.y1 > src.y2) {
+		lcdFillRect(dev, r.x1, r.y1, r.x2, r.y2, fill);
+		return;
+	}
+	lcdCopyRect(dev, &src, dx, dy);
+
+	if (dy > 0) lcdFillRect(dev, r.x1, r.y1, r.x2, r.y1+dy-1, fill);
+	else if (dy < 0) lcdFillRect(dev, r.x1, r.y2+dy+1, r.x2, r.y2, fill);
+	if (dx > 0) lcdFillRect(dev, r.x1, r.y1, r.x1+dx-1, r.y2, fill);
+	else if (dx < 0) lcdFillRect(dev, r.x2+dx+1, r.y1, r.x2, r.y2, fill);
+}
+
+// Scroll image in frame buffer by one pixel, wrapping around
+// SCROLL_RIGHT, SCROLL_LEFT: rows start to end-1
+// SCROLL_UP, SCROLL_DOWN: columns start to end
 void lcdWrapArround(TFT_t *dev, scroll_t scroll, int32_t start, int32_t end) {
 	if (dev->_use_frame_buffer == false) return;
 
 	int32_t _width = dev->_width;
 	int32_t _height = dev->_height;
-	int32_t index1;
-	int32_t index2;
-
-	if (scroll == SCROLL_RIGHT) {
-		uint16_t wk[_width];
-		for (int32_t i=start;i<end;i++) {
-			index1 = i * _width;
-			memcpy((char *)wk, (char*)&dev->_frame_buffer[index1], _width*2);
-			index2 = index1 + _width - 1;
-			dev->_frame_buffer[index1] = dev->_frame_buffer[index2];
-			memcpy((char *)&dev->_frame_buffer[index1+1], (char *)&wk[0], (_width-1)*2);
-		}
-	} else if (scroll == SCROLL_LEFT) {
-		uint16_t wk[_width];
-		for (int32_t i=start;i<end;i++) {
-			index1 = i * _width;
-			memcpy((char *)wk, (char*)&dev->_frame_buffer[index1], _width*2);
-			index2 = index1 + _width - 1;
-			dev->_frame_buffer[index2] = dev->_frame_buffer[index1];
-			memcpy((char *)&dev->_frame_buffer[index1], (char *)&wk[1], (_width-1)*2);
-		}
-	} else if (scroll == SCROLL_UP) {
-		uint16_t wk;
-		for (int32_t i=start;i<=end;i++) {
-			wk = dev->_frame_buffer[i];
-			for (int32_t j=0;j<_height-1;j++) {
-				index1 = j * _width + i;
-				index2 = (j+1) * _width + i;
-				dev->_frame_buffer[index1] = dev->_frame_buffer[index2];
-			}
-			index2 = (_height-1) * _width + i;
-			dev->_frame_buffer[index2] = wk;
-		}
-	} else if (scroll == SCROLL_DOWN) {
-		uint16_t wk;
-		for (int32_t i=start;i<=end;i++) {
-			index2 = (_height-1) * _width + i;
-			wk = dev->_frame_buffer[index2];
-			for (int32_t j=_height-2;j>=0;j--) {
-				index1 = j * _width + i;
-				index2 = (j+1) * _width + i;
-				dev->_frame_buffer[index2] = dev->_frame_buffer[index1];
-			}
-			dev->_frame_buffer[i] = wk;
-		}
+	uint16_t *fb = dev->_frame_buffer;
+
+	if (scroll == SCROLL_RIGHT || scroll == SCROLL_LEFT) {
+		if (start < 0) start = 0; // clip
+		if (end > _height) end = _height;
+		if (start >= end) return;
+		// save the column pushed out, move the rest, put it on the other side
+		bool right = (scroll == SCROLL_RIGHT);
+		int32_t out = right ? _width-1 : 0;
+		uint16_t wk[end-start];
+		for (int32_t i=start;i<end;i++) wk[i-start] = fb[i*_width+out];
+		rect_t r = {right ? 0 : 1, start, right ? _width-2 : _width-1, end-1};
+		lcdCopyRect(dev, &r, right ? 1 : -1, 0);
+		for (int32_t i=start;i<end;i++) fb[i*_width+_width-1-out] = wk[i-start];
+	} else if (scroll == SCROLL_UP || scroll == SCROLL_DOWN) {
+		if (start < 0) start = 0; // clip
+		if (end >= _width) end = _width-1;
+		if (start > end) return;
+		// save the row pushed out, move the rest, put it on the other side
+		bool up = (scroll == SCROLL_UP);
+		int32_t out = up ? 0 : _height-1;
+		size_t size = (end-start+1)*sizeof(uint16_t);
+		uint16_t wk[end-start+1];
+		memcpy(wk, &fb[out*_width+start], size);
+		rect_t r = {start, up ? 1 : 0, end, up ? _height-1 : _height-2};
+		lcdCopyRect(dev, &r, 0, up ? -1 : 1);
+		memcpy(&fb[(_height-1-out)*_width+start], wk, size);
 	}
 }
 
@@ -1349,12 +2836,15 @@ void lcdWriteFrame(TFT_t *dev)
 {
 	if (dev->_use_frame_buffer == false) return;
 
+	// only the rows the panel shows, all of them outside partial mode
+	int32_t y1 = dev->_active_y1, y2 = dev->_active_y2;
 	spi_master_write_command(dev, 0x2A); // set column(x) address
 	spi_master_write_addr(dev, dev->_offsetx, dev->_offsetx+dev->_width-1);
 	spi_master_write_command(dev, 0x2B); // set Page(y) address
-	spi_master_write_addr(dev, dev->_offsety, dev->_offsety+dev->_height-1);
+	spi_master_write_addr(dev, dev->_offsety+y1, dev->_offsety+y2);
 	spi_master_write_command(dev, 0x2C); // Memory Write
-	spi_master_write_colors(dev, dev->_frame_buffer, dev->_width*dev->_height);
+	spi_master_write_colors(dev, dev->_frame_buffer + y1*dev->_width, dev->_width*(y2-y1+1));
+	dev->_dirty_count = 0;
 
 #if 0
 	size_t size = dev->_width*dev->_height;
@@ -1369,3 +2859,157 @@ void lcdWriteFrame(TFT_t *dev)
 #endif
 	return;
 }
+
+// Pixels a separate window write costs beyond its data (5 transactions),
+// used when deciding whether two dirty regions should merge.
+#ifndef CONFIG_DIRTY_SLACK
+#define CONFIG_DIRTY_SLACK 64
+#endif
+
+static inline int32_t rect_area(const rect_t *r)
+{
+	return (r->x2-r->x1+1)*(r->y2-r->y1+1);
+}
+
+static inline rect_t rect_union(const rect_t *a, const rect_t *b)
+{
+	rect_t u = *a;
+	if (b->x1 < u.x1) u.x1 = b->x1;
+	if (b->y1 < u.y1) u.y1 = b->y1;
+	if (b->x2 > u.x2) u.x2 = b->x2;
+	if (b->y2 > u.y2) u.y2 = b->y2;
+	return u;
+}
+
+// Add a region to a list, merging it with any region where their bounding
+// box costs no more to send than the two separately. When the list is
+// full, merge with the region that grows the least.
+static void rect_list_add(rect_t *list, int32_t *count, rect_t r)
+{
+	for (int32_t i = 0; i < *count; ) {
+		rect_t u = rect_union(&r, &list[i]);
+		if (rect_area(&u) <= rect_area(&r) + rect_area(&list[i]) + CONFIG_DIRTY_SLACK) {
+			// absorb region i and rescan, r may now reach others
+			r = u;
+			list[i] = list[--(*count)];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	if (*count == CONFIG_DIRTY_RECTS) {
+		int32_t best = 0, best_cost = INT32_MAX;
+		for (int32_t i = 0; i < *count; i++) {
+			rect_t u = rect_union(&r, &list[i]);
+			int32_t cost = rect_area(&u) - rect_area(&list[i]);
+			if (cost < best_cost) {best = i; best_cost = cost;}
+		}
+		list[best] = rect_union(&r, &list[best]);
+		return;
+	}
+	list[(*count)++] = r;
+}
+
+// Clip a region to the screen, return false if nothing is left
+static bool rect_clip(TFT_t *dev, rect_t *r)
+{
+	if (r->x2 < 0 || r->x1 >= dev->_width) return false; // off screen
+	if (r->y2 < 0 || r->y1 >= dev->_height) return false;
+	if (r->x1 < 0) r->x1 = 0; // clip
+	if (r->x2 >= dev->_width) r->x2 = dev->_width-1;
+	if (r->y1 < 0) r->y1 = 0;
+	if (r->y2 >= dev->_height) r->y2 = dev->_height-1;
+	return r->x1 <= r->x2 && r->y1 <= r->y2;
+}
+
+// Mark a region of the frame buffer as changed
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+void lcdDirtyAdd(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	rect_t r = {x1, y1, x2, y2};
+	if (rect_clip(dev, &r)) rect_list_add(dev->_dirty, &dev->_dirty_count, r);
+}
+
+// Write the dirty regions of the frame buffer to the display
+void lcdWriteDirty(TFT_t *dev)
+{
+	if (dev->_use_frame_buffer == false) {
+		dev->_dirty_count = 0;
+		return;
+	}
+
+	for (int32_t i = 0; i < dev->_dirty_count; i++) {
+		rect_t *r = &dev->_dirty[i];
+		if (r->y1 < dev->_active_y1) r->y1 = dev->_active_y1; // partial mode
+		if (r->y2 > dev->_active_y2) r->y2 = dev->_active_y2;
+		if (r->y1 > r->y2) continue;
+		int32_t w = r->x2-r->x1+1;
+		uint16_t *src = dev->_frame_buffer + r->y1*dev->_width + r->x1;
+		lcd_set_window(dev, r->x1, r->y1, r->x2, r->y2);
+		if (w == dev->_width) {
+			spi_master_write_colors(dev, src, w*(r->y2-r->y1+1));
+		} else {
+			for (int32_t j = r->y1; j <= r->y2; j++, src += dev->_width) {
+				spi_master_write_colors(dev, src, w);
+			}
+		}
+	}
+	dev->_dirty_count = 0;
+}
+
+// Register a static background for the frame buffer, or NULL to remove it.
+// The background is copied to the frame buffer once; after that only
+// regions marked with lcdBackgroundMark are restored from it.
+// bg:background in screen coordinates, kept by the caller
+void lcdBackgroundSet(TFT_t *dev, const surface_t *bg)
+{
+	dev->_background = bg;
+	dev->_drawn_count = 0;
+	if (bg == NULL || dev->_use_frame_buffer == false) return;
+	dev->_drawn[dev->_drawn_count++] = (rect_t){0, 0, dev->_width-1, dev->_height-1};
+	lcdBackgroundRestore(dev);
+}
+
+// Mark a region drawn over the background this frame. It is flushed by
+// lcdWriteDirty and restored by the next lcdBackgroundRestore.
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+void lcdBackgroundMark(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	rect_t r = {x1, y1, x2, y2};
+	if (!rect_clip(dev, &r)) return;
+	rect_list_add(dev->_dirty, &dev->_dirty_count, r);
+	if (dev->_background != NULL) rect_list_add(dev->_drawn, &dev->_drawn_count, r);
+}
+
+// Copy the background back over the regions marked since the last
+// restore, one row copy per region row. Call at the start of a frame.
+void lcdBackgroundRestore(TFT_t *dev)
+{
+	const surface_t *bg = dev->_background;
+	if (bg == NULL || dev->_use_frame_buffer == false) {
+		dev->_drawn_count = 0;
+		return;
+	}
+
+	for (int32_t i = 0; i < dev->_drawn_count; i++) {
+		rect_t r = dev->_drawn[i];
+		// the background may be smaller than the screen
+		if (r.x2 >= bg->width) r.x2 = bg->width-1;
+		if (r.y2 >= bg->height) r.y2 = bg->height-1;
+		if (r.x1 > r.x2 || r.y1 > r.y2) continue;
+		size_t size = (r.x2-r.x1+1)*sizeof(uint16_t);
+		const uint16_t *src = bg->pixels + r.y1*bg->stride + r.x1;
+		uint16_t *dst = dev->_frame_buffer + r.y1*dev->_width + r.x1;
+		for (int32_t j = r.y1; j <= r.y2; j++, src += bg->stride, dst += dev->_width) {
+			memcpy(dst, src, size);
+		}
+		rect_list_add(dev->_dirty, &dev->_dirty_count, r);
+	}
+	dev->_drawn_count = 0;
+}
@@ -7,6 +7,10 @@
 #include <stdbool.h>
 #include "driver/spi_master.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define rgb565(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3))
 
 #define RED    rgb565(255,   0,   0) // 0xf800
@@ -19,6 +23,10 @@
 #define CYAN   rgb565(  0, 156, 209) // 0x04FA
 #define PURPLE rgb565(128,   0, 128) // 0x8010
 
+// lcdConvertRGB888 flags
+#define RGB_DITHER  0x1 // 4x4 ordered dither instead of truncation
+#define RGB_SWAPPED 0x2 // panel byte order, as Rgb565Swapped in lcd_surface.hpp
+
 #define LCD_CHAR_W 6
 #define LCD_CHAR_H 8
 
@@ -34,6 +42,16 @@
 #define LCD_H 240
 #endif
 
+// Number of dirty regions tracked before they are forced to merge
+#ifndef CONFIG_DIRTY_RECTS
+#define CONFIG_DIRTY_RECTS 16
+#endif
+
+// Number of staging buffers per device for queued pixel writes
+#ifndef CONFIG_DMA_RING
+#define CONFIG_DMA_RING 3
+#endif
+
 typedef enum {DIRECTION0, DIRECTION90, DIRECTION180, DIRECTION270} direction_t;
 
 typedef enum {
@@ -43,23 +61,110 @@ typedef enum {
 	SCROLL_UP = 4,
 } scroll_t;
 
+typedef enum {JOIN_NONE, JOIN_BEVEL, JOIN_MITER} join_t;
+
+typedef struct {
+	int32_t x;
+	int32_t y;
+} point_t;
+
+// Rectangle with inclusive corners
+typedef struct {
+	int32_t x1;
+	int32_t y1;
+	int32_t x2;
+	int32_t y2;
+} rect_t;
+
+// Block of RGB565 pixels, e.g. a sprite or an offscreen buffer
+typedef struct {
+	int32_t width;
+	int32_t height;
+	int32_t stride; // elements between rows
+	const uint16_t *pixels;
+} surface_t;
+
+// Source to screen transform, all 16.16 fixed point:
+// x' = a*x + b*y + tx
+// y' = c*x + d*y + ty
+typedef struct {
+	int32_t a, b;
+	int32_t c, d;
+	int32_t tx, ty;
+} affine_t;
+
+// Panel wiring and geometry for lcdInitConfig. Panels on the same SPI
+// host share the bus, each with its own CS and DC pins.
+typedef struct {
+	spi_host_device_t host;
+	int16_t mosi;
+	int16_t sclk;
+	int16_t cs;
+	int16_t dc;
+	int16_t reset; // -1 if not connected
+	int16_t bl;    // -1 if not connected
+	int32_t clock_speed_hz;
+	int32_t width;
+	int32_t height;
+	int32_t offsetx;
+	int32_t offsety;
+	int32_t gram_width;  // controller memory size, 0 for width+offsetx
+	int32_t gram_height; // 0 for height+offsety
+} lcd_config_t;
+
+// A device owns its SPI staging buffers and transactions, so different
+// devices may be drawn from different tasks at the same time. One device
+// is drawn by one task at a time.
 typedef struct {
 	int32_t     _width;
 	int32_t     _height;
 	int32_t     _offsetx;
 	int32_t     _offsety;
+	int32_t     _gram_width;
+	int32_t     _gram_height;
 	direction_t _font_direction;
 	uint8_t     _font_size;
 	bool        _font_back_en;
 	uint16_t    _font_back_color;
+	const uint8_t *_font; // glyphs, NULL draws no text
 	int8_t      _dc;
 	int8_t      _bl;
+	int8_t      _dc_level;
 	spi_device_handle_t _SPIHandle;
+	uint16_t   *_buffer; // DMA staging for polled writes
+	uint16_t   *_ring;   // DMA staging for queued writes, CONFIG_DMA_RING buffers
+	spi_transaction_t _trans[CONFIG_DMA_RING];
+	int32_t     _queued; // ring transactions in flight
+	int32_t     _slot;   // next ring buffer
 	bool        _use_frame_buffer;
 	uint16_t   *_frame_buffer;
+	rect_t      _dirty[CONFIG_DIRTY_RECTS]; // changed since the last flush
+	int32_t     _dirty_count;
+	rect_t      _drawn[CONFIG_DIRTY_RECTS]; // drawn over the background this frame
+	int32_t     _drawn_count;
+	const surface_t *_background;
+	int32_t     _active_y1; // rows shown, less than all in partial mode
+	int32_t     _active_y2;
 } TFT_t;
 
+typedef struct {
+	int32_t     _x;
+	int32_t     _y;
+	int32_t     _width;
+	int32_t     _height;
+	int32_t     _max_len;
+	uint8_t     _font_size;
+	const uint8_t *_font;
+	uint16_t    _color;
+	uint16_t    _back_color;
+	char       *_text;
+	uint16_t   *_pixels;
+	bool        _changed;   // rasterized since it was last drawn
+} label_t;
+
 void lcdInit(TFT_t *dev);
+bool lcdInitConfig(TFT_t *dev, const lcd_config_t *cfg);
+void lcdWait(TFT_t *dev);
 
 // Draw (outline) and fill primitives
 void lcdFillScreen(TFT_t *dev, uint16_t color);
@@ -68,30 +173,61 @@ void lcdDrawMultiPixels(TFT_t *dev, int32_t x, int32_t y, int32_t size, uint16_t
 void lcdDrawHLine(TFT_t *dev, int32_t x, int32_t y, int32_t w, uint16_t color);
 void lcdDrawVLine(TFT_t *dev, int32_t x, int32_t y, int32_t h, uint16_t color);
 void lcdDrawLine(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdDrawThickLine(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t width, uint16_t color);
+void lcdDrawPolyline(TFT_t *dev, const point_t *points, int32_t n, int32_t width, join_t join, uint16_t color);
 void lcdDrawRect(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
 void lcdFillRect(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdFillGradientH(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t c0, uint16_t c1);
+void lcdFillGradientV(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t c0, uint16_t c1);
+void lcdFillPattern(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint16_t *pattern);
+void lcdDrawHLineAlpha(TFT_t *dev, int32_t x, int32_t y, int32_t w, uint16_t color, uint8_t alpha);
+void lcdFillRectAlpha(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color, uint8_t alpha);
+void lcdDrawBitmap(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, int32_t stride);
+void lcdDrawBitmapRotated(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, int32_t stride, direction_t dir);
+void lcdDrawBitmapAlpha(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels, uint8_t alpha);
 void lcdDrawTri(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
 void lcdFillTri(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdFillTris(TFT_t *dev, const point_t *verts, const uint16_t *indices, int32_t n, const uint16_t *colors);
 void lcdDrawCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color);
 void lcdFillCircle(TFT_t *dev, int32_t x0, int32_t y0, int32_t r, uint16_t color);
+void lcdFillRing(TFT_t *dev, int32_t x0, int32_t y0, int32_t r1, int32_t r2, uint16_t color);
+void lcdFillArc(TFT_t *dev, int32_t x0, int32_t y0, int32_t r1, int32_t r2, int32_t start, int32_t end, uint16_t color);
 void lcdDrawRoundRect(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t r, uint16_t color);
 void lcdDrawArrow(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t w, uint16_t color);
 void lcdFillArrow(TFT_t *dev, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t w, uint16_t color);
+void lcdFillPolygon(TFT_t *dev, const point_t *points, int32_t n, uint16_t color);
 
 // Specify center and size of shape
 void lcdDrawRectangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
 void lcdDrawTriangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
 void lcdDrawRegularPolygon(TFT_t *dev, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color);
+void lcdFillRectangle(TFT_t *dev, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
+void lcdFillRegularPolygon(TFT_t *dev, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color);
 
 // Characters and strings
 int32_t lcdDrawChar(TFT_t *dev, int32_t x, int32_t y, char ascii, uint16_t color);
 int32_t lcdDrawString(TFT_t *dev, int32_t x, int32_t y, char *ascii, uint16_t color);
 
+// Cached text labels, redrawn with a block copy
+bool lcdLabelCreate(TFT_t *dev, label_t *label, int32_t x, int32_t y, int32_t max_len);
+bool lcdLabelSet(label_t *label, const char *ascii, uint16_t color, uint16_t back_color);
+void lcdLabelDraw(TFT_t *dev, label_t *label);
+void lcdLabelDelete(label_t *label);
+
+// Surfaces, scaled and transformed
+void lcdAffineRotateScale(affine_t *m, const surface_t *src, int32_t xc, int32_t yc, int32_t scale, int32_t angle);
+void lcdDrawSurfaceScaled(TFT_t *dev, const surface_t *src, int32_t x, int32_t y, int32_t scale);
+void lcdDrawSurfaceAffine(TFT_t *dev, const surface_t *src, const affine_t *m, int32_t key);
+
+// Color conversion
+void lcdConvertRGB888(uint16_t *dst, const uint8_t *rgb, int32_t w, int32_t h, int32_t x, int32_t y, uint32_t flags);
+
 // Font parameters
-void lcdSetFontDirection(TFT_t *dev, direction_t dir); // not implemented, always 0
+void lcdSetFontDirection(TFT_t *dev, direction_t dir);
 void lcdSetFontSize(TFT_t *dev, uint8_t size);
 void lcdSetFontBackground(TFT_t *dev, uint16_t color);
 void lcdNoFontBackground(TFT_t *dev);
+void lcdSetFont(TFT_t *dev, const uint8_t *font);
 
 // Display configuration
 void lcdSPIClockSpeed(int32_t speed);
@@ -101,9 +237,30 @@ void lcdBacklightOff(TFT_t *dev);
 void lcdBacklightOn(TFT_t *dev);
 void lcdInversionOff(TFT_t *dev);
 void lcdInversionOn(TFT_t *dev);
+void lcdPartialOn(TFT_t *dev, int32_t y1, int32_t y2);
+void lcdPartialOff(TFT_t *dev);
+void lcdIdleOn(TFT_t *dev);
+void lcdIdleOff(TFT_t *dev);
 void lcdFrameEnable(TFT_t *dev);
 void lcdFrameDisable(TFT_t *dev);
+void lcdCopyRect(TFT_t *dev, const rect_t *src, int32_t dx, int32_t dy);
+void lcdScrollRect(TFT_t *dev, const rect_t *rect, int32_t dx, int32_t dy, uint16_t fill);
 void lcdWrapArround(TFT_t *dev, scroll_t scroll, int32_t start, int32_t end);
 void lcdWriteFrame(TFT_t *dev);
+void lcdWindowBegin(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+void lcdWindowWrite(TFT_t *dev, const uint16_t *colors, size_t size);
+
+// Dirty regions of the frame buffer, flushed with lcdWriteDirty
+void lcdDirtyAdd(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+void lcdWriteDirty(TFT_t *dev);
+
+// Static background restored only where objects were drawn
+void lcdBackgroundSet(TFT_t *dev, const surface_t *bg);
+void lcdBackgroundMark(TFT_t *dev, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+void lcdBackgroundRestore(TFT_t *dev);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // LCD_H_
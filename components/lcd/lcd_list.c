@@ -0,0 +1,472 @@
+#include <string.h> // strlen, memcpy
+#include <stdlib.h> // abs
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_list.h"
+
+#define TAG "lcd_list"
+
+#ifndef CONFIG_LIST_STACK
+#define CONFIG_LIST_STACK 4096
+#endif
+
+typedef enum {
+	LIST_FILL_SCREEN,
+	LIST_PIXEL,
+	LIST_LINE,
+	LIST_RECT,
+	LIST_FILL_RECT,
+	LIST_FILL_TRI,
+	LIST_CIRCLE,
+	LIST_FILL_CIRCLE,
+	LIST_STRING,
+	LIST_FILL_CLIPPED, // fill screen cut to the rectangles in _clip
+	LIST_CULLED,       // hidden, not drawn
+} list_op_t;
+
+// Replay the commands on a device. Commands are moved up by oy, the first
+// row of the band, and the primitives clip them to the band.
+static void list_replay(const displaylist_t *list, TFT_t *dev, int32_t oy)
+{
+	for (int32_t i = 0; i < list->_count; i++) {
+		const list_cmd_t *c = &list->_cmds[i];
+		const int32_t *v = c->_v;
+		switch (c->_op) {
+		case LIST_FILL_SCREEN:
+			lcdFillScreen(dev, c->_color);
+			break;
+		case LIST_PIXEL:
+			lcdDrawPixel(dev, v[0], v[1]-oy, c->_color);
+			break;
+		case LIST_LINE:
+			lcdDrawLine(dev, v[0], v[1]-oy, v[2], v[3]-oy, c->_color);
+			break;
+		case LIST_RECT:
+			lcdDrawRect(dev, v[0], v[1]-oy, v[2], v[3]-oy, c->_color);
+			break;
+		case LIST_FILL_RECT:
+			lcdFillRect(dev, v[0], v[1]-oy, v[2], v[3]-oy, c->_color);
+			break;
+		case LIST_FILL_TRI:
+			lcdFillTri(dev, v[0], v[1]-oy, v[2], v[3]-oy, v[4], v[5]-oy, c->_color);
+			break;
+		case LIST_CIRCLE:
+			lcdDrawCircle(dev, v[0], v[1]-oy, v[2], c->_color);
+			break;
+		case LIST_FILL_CIRCLE:
+			lcdFillCircle(dev, v[0], v[1]-oy, v[2], c->_color);
+			break;
+		case LIST_STRING:
+			dev->_font_size = c->_font_size;
+			dev->_font_direction = c->_font_direction;
+			dev->_font_back_en = c->_font_back_en;
+			dev->_font_back_color = c->_back_color;
+			lcdDrawString(dev, v[0], v[1]-oy, list->_text + v[2], c->_color);
+			break;
+		case LIST_FILL_CLIPPED:
+			for (int32_t k = v[0]; k < v[0]+v[1]; k++) {
+				const rect_t *r = &list->_clip[k];
+				lcdFillRect(dev, r->x1, r->y1-oy, r->x2, r->y2-oy, c->_color);
+			}
+			break;
+		}
+	}
+}
+
+// Box around the first n points of v
+static void list_box(rect_t *b, const int32_t *v, int32_t n)
+{
+	b->x1 = b->x2 = v[0];
+	b->y1 = b->y2 = v[1];
+	for (int32_t i = 2; i < 2*n; i += 2) {
+		if (v[i] < b->x1) b->x1 = v[i];
+		if (v[i] > b->x2) b->x2 = v[i];
+		if (v[i+1] < b->y1) b->y1 = v[i+1];
+		if (v[i+1] > b->y2) b->y2 = v[i+1];
+	}
+}
+
+// Screen box around the pixels a command may write, clipped to the
+// screen. Return false if it writes none.
+static bool list_bounds(const displaylist_t *list, const list_cmd_t *c, rect_t *b)
+{
+	const TFT_t *dev = list->_dev;
+	const int32_t *v = c->_v;
+	int32_t r, w, h;
+	switch (c->_op) {
+	case LIST_FILL_SCREEN:
+		b->x1 = 0; b->y1 = 0;
+		b->x2 = dev->_width-1; b->y2 = dev->_height-1;
+		return true;
+	case LIST_PIXEL:
+		list_box(b, v, 1);
+		break;
+	case LIST_FILL_RECT: // drawn as given, nothing if the corners are swapped
+		if (v[0] > v[2] || v[1] > v[3]) return false;
+		list_box(b, v, 2);
+		break;
+	case LIST_LINE:
+	case LIST_RECT:
+		list_box(b, v, 2);
+		break;
+	case LIST_FILL_TRI:
+		list_box(b, v, 3);
+		break;
+	case LIST_CIRCLE:
+	case LIST_FILL_CIRCLE:
+		r = abs(v[2]);
+		b->x1 = v[0]-r; b->x2 = v[0]+r;
+		b->y1 = v[1]-r; b->y2 = v[1]+r;
+		break;
+	case LIST_STRING: // drawn in the recorded font direction
+		w = strlen(list->_text + v[2])*LCD_CHAR_W*c->_font_size;
+		h = LCD_CHAR_H*c->_font_size;
+		if (w == 0) return false;
+		switch (c->_font_direction) {
+		case DIRECTION90:  *b = (rect_t){v[0]-h+1, v[1], v[0], v[1]+w-1}; break;
+		case DIRECTION180: *b = (rect_t){v[0]-w+1, v[1]-h+1, v[0], v[1]}; break;
+		case DIRECTION270: *b = (rect_t){v[0], v[1]-w+1, v[0]+h-1, v[1]}; break;
+		default:           *b = (rect_t){v[0], v[1], v[0]+w-1, v[1]+h-1}; break;
+		}
+		break;
+	default:
+		return false;
+	}
+	if (b->x2 < 0 || b->x1 >= dev->_width) return false; // off screen
+	if (b->y2 < 0 || b->y1 >= dev->_height) return false;
+	if (b->x1 < 0) b->x1 = 0; // clip
+	if (b->x2 >= dev->_width) b->x2 = dev->_width-1;
+	if (b->y1 < 0) b->y1 = 0;
+	if (b->y2 >= dev->_height) b->y2 = dev->_height-1;
+	return true;
+}
+
+// Pixel writes of a command with screen box b, exact for rectangles and
+// estimated from the box for the other shapes
+static int32_t list_pixels(const list_cmd_t *c, const rect_t *b)
+{
+	int32_t w = b->x2-b->x1+1, h = b->y2-b->y1+1;
+	switch (c->_op) {
+	case LIST_LINE:        return (w > h) ? w : h;
+	case LIST_RECT:        return 2*(w+h);
+	case LIST_FILL_TRI:    return w*h/2;
+	case LIST_CIRCLE:      return w*22/7;
+	case LIST_FILL_CIRCLE: return w*h*11/14;
+	case LIST_STRING:      return c->_font_back_en ? w*h : w*h/4;
+	default:               return w*h;
+	}
+}
+
+static inline int32_t list_area(const rect_t *r)
+{
+	return (r->x2-r->x1+1)*(r->y2-r->y1+1);
+}
+
+// Keep an occluder, in place of the smallest one when the set is full
+static void list_occluder_add(rect_t *occ, int32_t *nocc, const rect_t *r)
+{
+	if (*nocc < LIST_OCCLUDERS) {
+		occ[(*nocc)++] = *r;
+		return;
+	}
+	int32_t min = 0;
+	for (int32_t k = 1; k < LIST_OCCLUDERS; k++) {
+		if (list_area(&occ[k]) < list_area(&occ[min])) min = k;
+	}
+	if (list_area(r) > list_area(&occ[min])) occ[min] = *r;
+}
+
+// Cut a fill screen command to the parts of the screen not covered by
+// the occluders. Pieces that do not fit in _clip are left uncut.
+static void list_clip_fill(displaylist_t *list, list_cmd_t *c, const rect_t *occ, int32_t nocc)
+{
+	rect_t *pieces = list->_clip + list->_clip_count;
+	int32_t room = LIST_CLIP_RECTS - list->_clip_count;
+	if (room < 1) return;
+	rect_t screen = {0, 0, list->_dev->_width-1, list->_dev->_height-1};
+	pieces[0] = screen;
+	int32_t n = 1;
+	for (int32_t k = 0; k < nocc; k++) {
+		const rect_t *o = &occ[k];
+		rect_t next[room];
+		int32_t nn = 0;
+		for (int32_t j = 0; j < n; j++) {
+			rect_t p = pieces[j];
+			if (o->x1 > p.x2 || o->x2 < p.x1 || o->y1 > p.y2 || o->y2 < p.y1) {
+				next[nn++] = p; // not covered
+				continue;
+			}
+			rect_t out[4]; // above, below, left and right of the occluder
+			int32_t no = 0;
+			int32_t y1 = (p.y1 > o->y1) ? p.y1 : o->y1;
+			int32_t y2 = (p.y2 < o->y2) ? p.y2 : o->y2;
+			if (p.y1 < o->y1) out[no++] = (rect_t){p.x1, p.y1, p.x2, o->y1-1};
+			if (p.y2 > o->y2) out[no++] = (rect_t){p.x1, o->y2+1, p.x2, p.y2};
+			if (p.x1 < o->x1) out[no++] = (rect_t){p.x1, y1, o->x1-1, y2};
+			if (p.x2 > o->x2) out[no++] = (rect_t){o->x2+1, y1, p.x2, y2};
+			if (nn + no + (n-j-1) > room) {
+				next[nn++] = p; // no room to split
+				continue;
+			}
+			for (int32_t i = 0; i < no; i++) next[nn++] = out[i];
+		}
+		memcpy(pieces, next, nn*sizeof(rect_t));
+		n = nn;
+	}
+	int32_t saved = list_area(&screen);
+	for (int32_t j = 0; j < n; j++) saved -= list_area(&pieces[j]);
+	list->_saved += saved;
+	if (n == 0) list->_culled++;
+	c->_op = LIST_FILL_CLIPPED;
+	c->_v[0] = list->_clip_count;
+	c->_v[1] = n;
+	list->_clip_count += n;
+}
+
+// Occlusion pass, before anything is drawn. Walking back from the last
+// command, opaque rectangles (fill rect and fill screen) are kept as
+// occluders. A command inside a later occluder is dropped, and a fill
+// screen that is left is cut to the parts the occluders do not cover.
+static void list_cull(displaylist_t *list)
+{
+	rect_t occ[LIST_OCCLUDERS];
+	int32_t nocc = 0;
+	list->_culled = 0;
+	list->_saved = 0;
+	list->_clip_count = 0;
+	for (int32_t i = list->_count-1; i >= 0; i--) {
+		list_cmd_t *c = &list->_cmds[i];
+		rect_t b;
+		if (!list_bounds(list, c, &b)) { // nothing on screen
+			c->_op = LIST_CULLED;
+			list->_culled++;
+			continue;
+		}
+		int32_t k = 0;
+		while (k < nocc && !(b.x1 >= occ[k].x1 && b.x2 <= occ[k].x2 && b.y1 >= occ[k].y1 && b.y2 <= occ[k].y2)) k++;
+		if (k < nocc) { // hidden
+			list->_saved += list_pixels(c, &b);
+			c->_op = LIST_CULLED;
+			list->_culled++;
+			continue;
+		}
+		bool opaque = (c->_op == LIST_FILL_SCREEN || c->_op == LIST_FILL_RECT);
+		if (c->_op == LIST_FILL_SCREEN && nocc > 0) list_clip_fill(list, c, occ, nocc);
+		if (opaque) list_occluder_add(occ, &nocc, &b);
+	}
+	ESP_LOGD(TAG, "culled %d commands, %d pixel writes", (int)list->_culled, (int)list->_saved);
+}
+
+// Worker task, replays the list into its band each time it is notified
+static void list_worker(void *arg)
+{
+	list_band_t *band = arg;
+	displaylist_t *list = band->_list;
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		if (list->_quit) break;
+		list_replay(list, &band->_dev, band->_y);
+		xSemaphoreGive(list->_done);
+	}
+	xSemaphoreGive(list->_done);
+	vTaskDelete(NULL);
+}
+
+// Create a display list and its workers, one pinned to each core
+// max_cmds:number of commands recorded before the list is rendered early
+// text_size:bytes for the strings of the text commands
+bool lcdListCreate(TFT_t *dev, displaylist_t *list, int32_t max_cmds, int32_t text_size)
+{
+	list->_dev = dev;
+	list->_count = 0;
+	list->_max = max_cmds;
+	list->_text_used = 0;
+	list->_text_size = text_size;
+	list->_quit = false;
+	list->_cull = false;
+	list->_clip_count = 0;
+	list->_culled = 0;
+	list->_saved = 0;
+	list->_cmds = heap_caps_malloc(sizeof(list_cmd_t)*max_cmds, MALLOC_CAP_8BIT);
+	list->_text = heap_caps_malloc(text_size, MALLOC_CAP_8BIT);
+	list->_done = xSemaphoreCreateCounting(LIST_BANDS, 0);
+	if (list->_cmds == NULL || list->_text == NULL || list->_done == NULL) {
+		ESP_LOGE(TAG, "alloc fail");
+		heap_caps_free(list->_cmds);
+		heap_caps_free(list->_text);
+		if (list->_done != NULL) vSemaphoreDelete(list->_done);
+		return false;
+	}
+
+	UBaseType_t prio = uxTaskPriorityGet(NULL);
+	for (int32_t i = 0; i < LIST_BANDS; i++) {
+		list_band_t *band = &list->_band[i];
+		band->_list = list;
+		if (xTaskCreatePinnedToCore(list_worker, "lcd_list", CONFIG_LIST_STACK, band, prio, &band->_task, i) != pdPASS) {
+			ESP_LOGE(TAG, "xTaskCreatePinnedToCore fail");
+			list->_quit = true;
+			for (int32_t j = 0; j < i; j++) {
+				xTaskNotifyGive(list->_band[j]._task);
+				xSemaphoreTake(list->_done, portMAX_DELAY);
+			}
+			heap_caps_free(list->_cmds);
+			heap_caps_free(list->_text);
+			vSemaphoreDelete(list->_done);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Draw the recorded commands into the frame buffer and clear the list.
+// Each worker owns a band of rows, so they run without locks; return when
+// both are done. Without a frame buffer the commands are drawn directly.
+// With culling enabled, hidden commands are dropped first.
+void lcdListRender(displaylist_t *list)
+{
+	TFT_t *dev = list->_dev;
+	if (list->_cull) list_cull(list);
+	if (dev->_use_frame_buffer == false) {
+		// strings set their recorded font on the caller's device, keep its own
+		direction_t font_direction = dev->_font_direction;
+		uint8_t font_size = dev->_font_size;
+		bool font_back_en = dev->_font_back_en;
+		uint16_t font_back_color = dev->_font_back_color;
+		list_replay(list, dev, 0);
+		dev->_font_direction = font_direction;
+		dev->_font_size = font_size;
+		dev->_font_back_en = font_back_en;
+		dev->_font_back_color = font_back_color;
+	} else {
+		for (int32_t i = 0; i < LIST_BANDS; i++) {
+			list_band_t *band = &list->_band[i];
+			band->_y = i*dev->_height/LIST_BANDS;
+			band->_height = (i+1)*dev->_height/LIST_BANDS - band->_y;
+			band->_dev = *dev;
+			band->_dev._frame_buffer = dev->_frame_buffer + band->_y*dev->_width;
+			band->_dev._height = band->_height;
+			xTaskNotifyGive(band->_task);
+		}
+		for (int32_t i = 0; i < LIST_BANDS; i++) {
+			xSemaphoreTake(list->_done, portMAX_DELAY);
+		}
+	}
+	list->_count = 0;
+	list->_text_used = 0;
+}
+
+// Render the list and write the frame once both bands are drawn
+void lcdListFlush(displaylist_t *list)
+{
+	lcdListRender(list);
+	lcdWriteFrame(list->_dev);
+}
+
+// Stop the workers and free the list
+void lcdListDelete(displaylist_t *list)
+{
+	list->_quit = true;
+	for (int32_t i = 0; i < LIST_BANDS; i++) {
+		xTaskNotifyGive(list->_band[i]._task);
+		xSemaphoreTake(list->_done, portMAX_DELAY);
+	}
+	vSemaphoreDelete(list->_done);
+	heap_caps_free(list->_cmds);
+	heap_caps_free(list->_text);
+	list->_cmds = NULL;
+	list->_text = NULL;
+}
+
+// Drop commands hidden by later opaque rectangles when the list is
+// rendered, and clip the background fill to what is left uncovered.
+// _culled and _saved report what each render avoided.
+void lcdListCullEnable(displaylist_t *list)
+{
+	list->_cull = true;
+}
+
+void lcdListCullDisable(displaylist_t *list)
+{
+	list->_cull = false;
+	list->_culled = 0;
+	list->_saved = 0;
+}
+
+// Append a command, rendering the list first if it is full
+static list_cmd_t *list_add(displaylist_t *list, list_op_t op, uint16_t color)
+{
+	if (list->_count == list->_max) lcdListRender(list);
+	list_cmd_t *c = &list->_cmds[list->_count++];
+	c->_op = op;
+	c->_color = color;
+	return c;
+}
+
+void lcdListFillScreen(displaylist_t *list, uint16_t color)
+{
+	list_add(list, LIST_FILL_SCREEN, color);
+}
+
+void lcdListDrawPixel(displaylist_t *list, int32_t x, int32_t y, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_PIXEL, color);
+	c->_v[0] = x; c->_v[1] = y;
+}
+
+void lcdListDrawLine(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_LINE, color);
+	c->_v[0] = x1; c->_v[1] = y1; c->_v[2] = x2; c->_v[3] = y2;
+}
+
+void lcdListDrawRect(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_RECT, color);
+	c->_v[0] = x1; c->_v[1] = y1; c->_v[2] = x2; c->_v[3] = y2;
+}
+
+void lcdListFillRect(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_FILL_RECT, color);
+	c->_v[0] = x1; c->_v[1] = y1; c->_v[2] = x2; c->_v[3] = y2;
+}
+
+void lcdListFillTri(displaylist_t *list, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_FILL_TRI, color);
+	c->_v[0] = x0; c->_v[1] = y0; c->_v[2] = x1; c->_v[3] = y1; c->_v[4] = x2; c->_v[5] = y2;
+}
+
+void lcdListDrawCircle(displaylist_t *list, int32_t x0, int32_t y0, int32_t r, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_CIRCLE, color);
+	c->_v[0] = x0; c->_v[1] = y0; c->_v[2] = r;
+}
+
+void lcdListFillCircle(displaylist_t *list, int32_t x0, int32_t y0, int32_t r, uint16_t color)
+{
+	list_cmd_t *c = list_add(list, LIST_FILL_CIRCLE, color);
+	c->_v[0] = x0; c->_v[1] = y0; c->_v[2] = r;
+}
+
+// The string is copied and drawn with the font settings of the device at
+// the time of the call
+void lcdListDrawString(displaylist_t *list, int32_t x, int32_t y, const char *ascii, uint16_t color)
+{
+	int32_t len = strlen(ascii)+1;
+	if (len > list->_text_size) {
+		ESP_LOGE(TAG, "string too long");
+		return;
+	}
+	if (list->_text_used + len > list->_text_size) lcdListRender(list);
+	list_cmd_t *c = list_add(list, LIST_STRING, color); // may render, text_used is then 0
+	memcpy(list->_text + list->_text_used, ascii, len);
+	c->_v[0] = x; c->_v[1] = y; c->_v[2] = list->_text_used;
+	list->_text_used += len;
+	c->_font_size = list->_dev->_font_size;
+	c->_font_direction = list->_dev->_font_direction;
+	c->_font_back_en = list->_dev->_font_back_en;
+	c->_back_color = list->_dev->_font_back_color;
+}
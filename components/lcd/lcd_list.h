@@ -0,0 +1,86 @@
+#ifndef LCD_LIST_H_
+#define LCD_LIST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of horizontal bands, one worker task per band and per core
+#define LIST_BANDS 2
+
+// Opaque rectangles tracked by the culling pass, and pieces the
+// background fill may be clipped into
+#define LIST_OCCLUDERS 8
+#define LIST_CLIP_RECTS 32
+
+// Recorded draw command
+typedef struct {
+	uint8_t     _op;
+	uint8_t     _font_size;
+	uint8_t     _font_direction; // direction_t
+	bool        _font_back_en;
+	uint16_t    _color;
+	uint16_t    _back_color;
+	int32_t     _v[6];      // coordinates, radius, text offset
+} list_cmd_t;
+
+struct displaylist;
+
+// Worker state, the device copy is a view of one band of the frame buffer
+typedef struct {
+	struct displaylist *_list;
+	TFT_t       _dev;
+	int32_t     _y;         // first frame buffer row of the band
+	int32_t     _height;
+	TaskHandle_t _task;
+} list_band_t;
+
+// Draw commands of a frame, replayed by one worker per band
+typedef struct displaylist {
+	TFT_t      *_dev;
+	list_cmd_t *_cmds;
+	int32_t     _count;
+	int32_t     _max;
+	char       *_text;      // strings of the text commands
+	int32_t     _text_used;
+	int32_t     _text_size;
+	bool        _quit;
+	SemaphoreHandle_t _done;
+	list_band_t _band[LIST_BANDS];
+	bool        _cull;      // drop hidden commands before rendering
+	rect_t      _clip[LIST_CLIP_RECTS]; // uncovered parts of the background fill
+	int32_t     _clip_count;
+	int32_t     _culled;    // commands dropped by the last render
+	int32_t     _saved;     // pixel writes avoided by the last render, estimated
+} displaylist_t;
+
+bool lcdListCreate(TFT_t *dev, displaylist_t *list, int32_t max_cmds, int32_t text_size);
+void lcdListRender(displaylist_t *list);
+void lcdListFlush(displaylist_t *list);
+void lcdListDelete(displaylist_t *list);
+void lcdListCullEnable(displaylist_t *list);
+void lcdListCullDisable(displaylist_t *list);
+
+// Recorded versions of the lcd.h primitives
+void lcdListFillScreen(displaylist_t *list, uint16_t color);
+void lcdListDrawPixel(displaylist_t *list, int32_t x, int32_t y, uint16_t color);
+void lcdListDrawLine(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdListDrawRect(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdListFillRect(displaylist_t *list, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdListFillTri(displaylist_t *list, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdListDrawCircle(displaylist_t *list, int32_t x0, int32_t y0, int32_t r, uint16_t color);
+void lcdListFillCircle(displaylist_t *list, int32_t x0, int32_t y0, int32_t r, uint16_t color);
+void lcdListDrawString(displaylist_t *list, int32_t x, int32_t y, const char *ascii, uint16_t color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_LIST_H_
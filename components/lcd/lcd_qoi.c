@@ -0,0 +1,165 @@
+#include <string.h> // memset, memcpy
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_qoi.h"
+
+#define TAG "lcd_qoi"
+
+// QOI format, see https://qoiformat.org/qoi-specification.pdf
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_SIZE 4096 // largest width or height accepted
+
+#define QOI_OP_INDEX 0x00 // 00xxxxxx
+#define QOI_OP_DIFF  0x40 // 01xxxxxx
+#define QOI_OP_LUMA  0x80 // 10xxxxxx
+#define QOI_OP_RUN   0xC0 // 11xxxxxx
+#define QOI_OP_RGB   0xFE // 11111110
+#define QOI_OP_RGBA  0xFF // 11111111
+#define QOI_MASK_2   0xC0 // 11000000
+
+#define QOI_HASH(p) (((p)[0]*3 + (p)[1]*5 + (p)[2]*7 + (p)[3]*11) & 63)
+
+static inline uint32_t qoi_read32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Start decoding a QOI image
+// data:QOI file contents
+// size:file size in bytes
+// Return false if the header is not valid.
+bool lcdQoiOpen(qoi_t *q, const uint8_t *data, size_t size)
+{
+	if (size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(data, "qoif", 4) != 0) {
+		ESP_LOGE(TAG, "not a QOI image");
+		return false;
+	}
+	uint32_t width = qoi_read32(data + 4);
+	uint32_t height = qoi_read32(data + 8);
+	if (width == 0 || height == 0 || width > QOI_MAX_SIZE || height > QOI_MAX_SIZE) {
+		ESP_LOGE(TAG, "bad QOI size %"PRIu32"x%"PRIu32, width, height);
+		return false;
+	}
+	q->_data = data;
+	q->_end = size - QOI_PADDING_SIZE;
+	q->_pos = QOI_HEADER_SIZE;
+	q->_width = width;
+	q->_height = height;
+	q->_row = 0;
+	q->_run = 0;
+	q->_px[0] = q->_px[1] = q->_px[2] = 0;
+	q->_px[3] = 255;
+	memset(q->_index, 0, sizeof(q->_index));
+	return true;
+}
+
+// Decode the next row of the image
+// row:_width RGB565 pixels
+// Return false when all rows have been decoded.
+bool lcdQoiRow(qoi_t *q, uint16_t *row)
+{
+	if (q->_row >= q->_height) return false;
+
+	const uint8_t *data = q->_data;
+	size_t pos = q->_pos;
+	uint8_t *px = q->_px;
+	uint16_t color = rgb565(px[0], px[1], px[2]);
+	for (int32_t x = 0; x < q->_width; ) {
+		if (q->_run > 0) {
+			// a run can continue into the next row
+			int32_t n = q->_width - x;
+			if (n > q->_run) n = q->_run;
+			q->_run -= n;
+			while (n--) row[x++] = color;
+			continue;
+		}
+		if (pos < q->_end) {
+			uint8_t b1 = data[pos++];
+			if (b1 == QOI_OP_RGB || b1 == QOI_OP_RGBA) {
+				size_t len = (b1 == QOI_OP_RGB) ? 3 : 4;
+				if (pos + len > q->_end) {
+					pos = q->_end; // truncated
+				} else {
+					memcpy(px, &data[pos], len);
+					pos += len;
+				}
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+				memcpy(px, q->_index[b1], 4);
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+				px[0] += ((b1 >> 4) & 0x03) - 2;
+				px[1] += ((b1 >> 2) & 0x03) - 2;
+				px[2] += ( b1       & 0x03) - 2;
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+				uint8_t b2 = (pos < q->_end) ? data[pos++] : 0x88;
+				int32_t vg = (b1 & 0x3F) - 32;
+				px[0] += vg - 8 + ((b2 >> 4) & 0x0F);
+				px[1] += vg;
+				px[2] += vg - 8 +  (b2       & 0x0F);
+			} else {
+				q->_run = (b1 & 0x3F); // this pixel plus _run more
+			}
+			memcpy(q->_index[QOI_HASH(px)], px, 4);
+			color = rgb565(px[0], px[1], px[2]);
+		}
+		// past the end of the data the last pixel repeats
+		row[x++] = color;
+	}
+	q->_pos = pos;
+	q->_row++;
+	return true;
+}
+
+// Draw a QOI image, decoding it row by row. In frame buffer mode rows go
+// straight into the frame buffer; in direct mode the visible part is sent
+// as one window. Memory use is one row, whatever the image height.
+// x:X coordinate of top left
+// y:Y coordinate of top left
+// data:QOI file contents
+// size:file size in bytes
+// Return false if the image is not valid or memory is short.
+bool lcdDrawQoi(TFT_t *dev, int32_t x, int32_t y, const uint8_t *data, size_t size)
+{
+	qoi_t q;
+	if (!lcdQoiOpen(&q, data, size)) return false;
+
+	int32_t x1 = x, x2 = x+q._width-1;
+	int32_t y1 = y, y2 = y+q._height-1;
+	if (x2 < 0 || x1 >= dev->_width) return true; // off screen
+	if (y2 < 0 || y1 >= dev->_height) return true;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+	int32_t n = x2-x1+1;
+
+	// rows that fit on screen decode in place in the frame buffer
+	bool in_place = dev->_use_frame_buffer && n == q._width && y1 == y;
+	uint16_t *row = NULL;
+	if (!in_place) {
+		row = heap_caps_malloc(sizeof(uint16_t)*q._width, MALLOC_CAP_DMA);
+		if (row == NULL) {
+			ESP_LOGE(TAG, "heap_caps_malloc fail");
+			return false;
+		}
+	}
+
+	if (!dev->_use_frame_buffer) lcdWindowBegin(dev, x1, y1, x2, y2);
+	for (int32_t j = y; j <= y2; j++) {
+		if (in_place) {
+			lcdQoiRow(&q, dev->_frame_buffer + j*dev->_width + x1);
+			continue;
+		}
+		lcdQoiRow(&q, row);
+		if (j < y1) continue; // above the screen
+		if (dev->_use_frame_buffer) {
+			memcpy(dev->_frame_buffer + j*dev->_width + x1, row + (x1-x), n*sizeof(uint16_t));
+		} else {
+			lcdWindowWrite(dev, row + (x1-x), n);
+		}
+	}
+	if (row != NULL) heap_caps_free(row);
+	return true;
+}
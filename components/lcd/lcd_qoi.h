@@ -0,0 +1,34 @@
+#ifndef LCD_QOI_H_
+#define LCD_QOI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming decoder state for a QOI image held in memory (e.g. flash)
+typedef struct {
+	const uint8_t *_data;
+	size_t      _end;       // end of the chunks, before the padding
+	size_t      _pos;
+	int32_t     _width;
+	int32_t     _height;
+	int32_t     _row;       // next row to decode
+	int32_t     _run;       // pixels left in the current run
+	uint8_t     _px[4];     // previous pixel, r g b a
+	uint8_t     _index[64][4];
+} qoi_t;
+
+bool lcdQoiOpen(qoi_t *q, const uint8_t *data, size_t size);
+bool lcdQoiRow(qoi_t *q, uint16_t *row);
+bool lcdDrawQoi(TFT_t *dev, int32_t x, int32_t y, const uint8_t *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_QOI_H_
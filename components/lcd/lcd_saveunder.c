@@ -0,0 +1,87 @@
+#include <string.h> // memcpy
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_saveunder.h"
+
+#define TAG "lcd_saveunder"
+
+// Create a save-under pool
+// size:number of pixels the pool can hold, the total area of the objects
+// drawn over the scene in one frame
+bool lcdSaveUnderCreate(saveunder_t *su, int32_t size)
+{
+	su->_pixels = heap_caps_malloc(sizeof(uint16_t)*size, MALLOC_CAP_8BIT);
+	if (su->_pixels == NULL) {
+		ESP_LOGE(TAG, "heap_caps_malloc fail");
+		return false;
+	}
+	su->_size = size;
+	su->_used = 0;
+	su->_count = 0;
+	return true;
+}
+
+// Save the frame buffer pixels under an object before it is drawn.
+// The region is also marked dirty, since the object will change it.
+// x1:Start X coordinate
+// y1:Start Y coordinate
+// x2:End X coordinate
+// y2:End Y coordinate
+// Return false if the pool is full or there is no frame buffer; the caller
+// then has to erase the object some other way.
+bool lcdSaveUnder(TFT_t *dev, saveunder_t *su, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+	if (dev->_use_frame_buffer == false) return false;
+	if (x2 < 0 || x1 >= dev->_width) return true; // off screen, nothing to save
+	if (y2 < 0 || y1 >= dev->_height) return true;
+	if (x1 < 0) x1 = 0; // clip
+	if (x2 >= dev->_width) x2 = dev->_width-1;
+	if (y1 < 0) y1 = 0;
+	if (y2 >= dev->_height) y2 = dev->_height-1;
+
+	int32_t w = x2-x1+1, h = y2-y1+1;
+	if (su->_count == CONFIG_SAVE_UNDER_RECTS || su->_used + w*h > su->_size) return false;
+
+	uint16_t *dst = su->_pixels + su->_used;
+	const uint16_t *src = dev->_frame_buffer + y1*dev->_width + x1;
+	for (int32_t j = 0; j < h; j++, dst += w, src += dev->_width) {
+		memcpy(dst, src, w*sizeof(uint16_t));
+	}
+	su->_rect[su->_count] = (rect_t){x1, y1, x2, y2};
+	su->_offset[su->_count++] = su->_used;
+	su->_used += w*h;
+	lcdDirtyAdd(dev, x1, y1, x2, y2);
+	return true;
+}
+
+// Put back everything saved since the last restore, in reverse order so
+// overlapping objects unwind correctly, and empty the pool. The restored
+// regions are marked dirty.
+void lcdSaveUnderRestore(TFT_t *dev, saveunder_t *su)
+{
+	if (dev->_use_frame_buffer == false) return;
+
+	while (su->_count > 0) {
+		su->_count--;
+		rect_t *r = &su->_rect[su->_count];
+		int32_t w = r->x2-r->x1+1;
+		const uint16_t *src = su->_pixels + su->_offset[su->_count];
+		uint16_t *dst = dev->_frame_buffer + r->y1*dev->_width + r->x1;
+		for (int32_t j = r->y1; j <= r->y2; j++, src += w, dst += dev->_width) {
+			memcpy(dst, src, w*sizeof(uint16_t));
+		}
+		lcdDirtyAdd(dev, r->x1, r->y1, r->x2, r->y2);
+	}
+	su->_used = 0;
+}
+
+void lcdSaveUnderDelete(saveunder_t *su)
+{
+	if (su->_pixels != NULL) heap_caps_free(su->_pixels);
+	su->_pixels = NULL;
+	su->_size = 0;
+	su->_used = 0;
+	su->_count = 0;
+}
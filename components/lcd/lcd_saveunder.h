@@ -0,0 +1,35 @@
+#ifndef LCD_SAVEUNDER_H_
+#define LCD_SAVEUNDER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of regions one save-under pool can hold
+#ifndef CONFIG_SAVE_UNDER_RECTS
+#define CONFIG_SAVE_UNDER_RECTS 16
+#endif
+
+typedef struct {
+	rect_t      _rect[CONFIG_SAVE_UNDER_RECTS];   // saved regions, in save order
+	int32_t     _offset[CONFIG_SAVE_UNDER_RECTS]; // start of each region in _pixels
+	int32_t     _count;
+	uint16_t   *_pixels; // pool of saved pixels
+	int32_t     _size;   // pool size in pixels
+	int32_t     _used;
+} saveunder_t;
+
+bool lcdSaveUnderCreate(saveunder_t *su, int32_t size);
+bool lcdSaveUnder(TFT_t *dev, saveunder_t *su, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+void lcdSaveUnderRestore(TFT_t *dev, saveunder_t *su);
+void lcdSaveUnderDelete(saveunder_t *su);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_SAVEUNDER_H_
@@ -0,0 +1,246 @@
+#include <string.h> // memset, memcpy, memcmp
+#include <stdlib.h> // abs
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_shape.h"
+
+#define TAG "lcd_shape"
+
+// Color a missed shape is drawn with on the zeroed scratch buffer
+#define SHAPE_INK 0xFFFF
+
+typedef enum {
+	SHAPE_FILL_TRI,
+	SHAPE_RECTANGLE,
+	SHAPE_TRIANGLE,
+	SHAPE_POLYGON,
+	SHAPE_FILL_RECTANGLE,
+	SHAPE_FILL_POLYGON,
+} shape_op_t;
+
+// Create a shape cache
+// max_shapes:number of shapes cached
+// max_spans:number of spans for all the shapes
+bool lcdShapeCacheCreate(shapecache_t *sc, int32_t max_shapes, int32_t max_spans)
+{
+	int32_t size = 1;
+	while (size < 2*max_shapes) size <<= 1; // table at most half full
+	sc->_size = size;
+	sc->_max_shapes = max_shapes;
+	sc->_max_spans = max_spans;
+	sc->_hits = 0;
+	sc->_misses = 0;
+	sc->_clears = 0;
+	sc->_table = heap_caps_malloc(sizeof(shape_entry_t)*size, MALLOC_CAP_8BIT);
+	sc->_spans = heap_caps_malloc(sizeof(shape_span_t)*max_spans, MALLOC_CAP_8BIT);
+	sc->_scratch = heap_caps_malloc(sizeof(uint16_t)*CONFIG_SHAPE_MAX_SIZE*CONFIG_SHAPE_MAX_SIZE, MALLOC_CAP_8BIT);
+	if (sc->_table == NULL || sc->_spans == NULL || sc->_scratch == NULL) {
+		ESP_LOGE(TAG, "heap_caps_malloc fail");
+		lcdShapeCacheDelete(sc);
+		return false;
+	}
+	lcdShapeCacheClear(sc);
+	return true;
+}
+
+// Forget all the cached shapes, the counters are kept
+void lcdShapeCacheClear(shapecache_t *sc)
+{
+	for (int32_t i = 0; i < sc->_size; i++) sc->_table[i]._first = -1;
+	sc->_count = 0;
+	sc->_used = 0;
+}
+
+void lcdShapeCacheDelete(shapecache_t *sc)
+{
+	if (sc->_table != NULL) heap_caps_free(sc->_table);
+	if (sc->_spans != NULL) heap_caps_free(sc->_spans);
+	if (sc->_scratch != NULL) heap_caps_free(sc->_scratch);
+	sc->_table = NULL;
+	sc->_spans = NULL;
+	sc->_scratch = NULL;
+}
+
+// Draw a shape with the lcd.h primitive of its key, origin at (x, y)
+static void shape_raster(TFT_t *dev, const int32_t *k, int32_t x, int32_t y, uint16_t color)
+{
+	switch (k[0]) {
+	case SHAPE_FILL_TRI:
+		lcdFillTri(dev, x, y, x+k[1], y+k[2], x+k[3], y+k[4], color);
+		break;
+	case SHAPE_RECTANGLE:
+		lcdDrawRectangle(dev, x, y, k[1], k[2], k[3], color);
+		break;
+	case SHAPE_TRIANGLE:
+		lcdDrawTriangle(dev, x, y, k[1], k[2], k[3], color);
+		break;
+	case SHAPE_POLYGON:
+		lcdDrawRegularPolygon(dev, x, y, k[1], k[2], k[3], color);
+		break;
+	case SHAPE_FILL_RECTANGLE:
+		lcdFillRectangle(dev, x, y, k[1], k[2], k[3], color);
+		break;
+	case SHAPE_FILL_POLYGON:
+		lcdFillRegularPolygon(dev, x, y, k[1], k[2], k[3], color);
+		break;
+	}
+}
+
+// Box around every pixel of a shape, relative to its origin
+static void shape_bounds(const int32_t *k, rect_t *b)
+{
+	int32_t r;
+	switch (k[0]) {
+	case SHAPE_FILL_TRI:
+		b->x1 = b->x2 = 0;
+		b->y1 = b->y2 = 0;
+		for (int32_t i = 1; i < 5; i += 2) {
+			if (k[i] < b->x1) b->x1 = k[i];
+			if (k[i] > b->x2) b->x2 = k[i];
+			if (k[i+1] < b->y1) b->y1 = k[i+1];
+			if (k[i+1] > b->y2) b->y2 = k[i+1];
+		}
+		return;
+	case SHAPE_POLYGON:
+	case SHAPE_FILL_POLYGON:
+		r = abs(k[2]) + 1;
+		break;
+	default: // rotated about the center, corners within half of w+h
+		r = (abs(k[1]) + abs(k[2]))/2 + 1;
+		break;
+	}
+	b->x1 = b->y1 = -r;
+	b->x2 = b->y2 = r;
+}
+
+// Table slot of a key, or the empty slot where it goes
+static shape_entry_t *shape_find(shapecache_t *sc, const int32_t *k)
+{
+	uint32_t h = 2166136261u; // FNV-1a over the words
+	for (int32_t i = 0; i < 5; i++) h = (h ^ (uint32_t)k[i]) * 16777619u;
+	int32_t mask = sc->_size-1;
+	for (int32_t i = (h ^ (h >> 16)) & mask; ; i = (i+1) & mask) {
+		shape_entry_t *e = &sc->_table[i];
+		if (e->_first < 0 || memcmp(e->_key, k, sizeof(e->_key)) == 0) return e;
+	}
+}
+
+// Rasterize a missed shape into the scratch buffer and store its spans.
+// Return NULL if the shape is too large to cache.
+static shape_entry_t *shape_add(shapecache_t *sc, const int32_t *k, shape_entry_t *e)
+{
+	rect_t b;
+	shape_bounds(k, &b);
+	int32_t w = b.x2-b.x1+1, h = b.y2-b.y1+1;
+	if (w > CONFIG_SHAPE_MAX_SIZE || h > CONFIG_SHAPE_MAX_SIZE) return NULL;
+
+	// a frame buffer device over the scratch buffer, the shape fits in it
+	TFT_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec._width = w;
+	rec._height = h;
+	rec._use_frame_buffer = true;
+	rec._frame_buffer = sc->_scratch;
+	memset(sc->_scratch, 0, sizeof(uint16_t)*w*h);
+	shape_raster(&rec, k, -b.x1, -b.y1, SHAPE_INK);
+
+	// count the runs first, a full cache is cleared before storing them
+	int32_t n = 0;
+	for (int32_t y = 0; y < h; y++) {
+		const uint16_t *row = sc->_scratch + y*w;
+		for (int32_t x = 0; x < w; x++) {
+			if (row[x] && (x == 0 || !row[x-1])) n++;
+		}
+	}
+	if (n > sc->_max_spans) return NULL;
+	if (sc->_count == sc->_max_shapes || sc->_used + n > sc->_max_spans) {
+		lcdShapeCacheClear(sc);
+		sc->_clears++;
+		e = shape_find(sc, k);
+	}
+
+	memcpy(e->_key, k, sizeof(e->_key));
+	e->_first = sc->_used;
+	e->_count = n;
+	shape_span_t *s = sc->_spans + sc->_used;
+	for (int32_t y = 0; y < h; y++) {
+		const uint16_t *row = sc->_scratch + y*w;
+		for (int32_t x = 0; x < w; x++) {
+			if (!row[x]) continue;
+			s->dy = y + b.y1;
+			s->x1 = x + b.x1;
+			while (x+1 < w && row[x+1]) x++;
+			s->x2 = x + b.x1;
+			s++;
+		}
+	}
+	sc->_used += n;
+	sc->_count++;
+	return e;
+}
+
+// Draw a shape at (x, y) from its cached spans, caching it on a miss
+static void shape_draw(TFT_t *dev, shapecache_t *sc, const int32_t *k, int32_t x, int32_t y, uint16_t color)
+{
+	shape_entry_t *e = shape_find(sc, k);
+	if (e->_first >= 0) {
+		sc->_hits++;
+	} else {
+		sc->_misses++;
+		e = shape_add(sc, k, e);
+		if (e == NULL) {
+			shape_raster(dev, k, x, y, color);
+			return;
+		}
+	}
+	const shape_span_t *s = sc->_spans + e->_first;
+	for (int32_t i = 0; i < e->_count; i++, s++) {
+		lcdDrawHLine(dev, x + s->x1, y + s->dy, s->x2 - s->x1 + 1, color);
+	}
+}
+
+// Angle in 0 to 359, so turns by whole circles share a cache entry
+static inline int32_t shape_angle(int32_t angle)
+{
+	angle %= 360;
+	return (angle < 0) ? angle + 360 : angle;
+}
+
+// Fill a triangle, cached by the vertices relative to the first
+void lcdShapeFillTri(TFT_t *dev, shapecache_t *sc, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_FILL_TRI, x1-x0, y1-y0, x2-x0, y2-y0};
+	shape_draw(dev, sc, k, x0, y0, color);
+}
+
+void lcdShapeDrawRectangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_RECTANGLE, w, h, shape_angle(angle), 0};
+	shape_draw(dev, sc, k, xc, yc, color);
+}
+
+void lcdShapeDrawTriangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_TRIANGLE, w, h, shape_angle(angle), 0};
+	shape_draw(dev, sc, k, xc, yc, color);
+}
+
+void lcdShapeDrawRegularPolygon(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_POLYGON, n, r, shape_angle(angle), 0};
+	shape_draw(dev, sc, k, xc, yc, color);
+}
+
+void lcdShapeFillRectangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_FILL_RECTANGLE, w, h, shape_angle(angle), 0};
+	shape_draw(dev, sc, k, xc, yc, color);
+}
+
+void lcdShapeFillRegularPolygon(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color)
+{
+	int32_t k[5] = {SHAPE_FILL_POLYGON, n, r, shape_angle(angle), 0};
+	shape_draw(dev, sc, k, xc, yc, color);
+}
@@ -0,0 +1,64 @@
+#ifndef LCD_SHAPE_H_
+#define LCD_SHAPE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest shape cached, in pixels across its bounding box. Larger shapes
+// are drawn directly.
+#ifndef CONFIG_SHAPE_MAX_SIZE
+#define CONFIG_SHAPE_MAX_SIZE 64
+#endif
+
+// Run of pixels in one row of a cached shape, relative to its origin
+typedef struct {
+	int16_t     dy;
+	int16_t     x1;
+	int16_t     x2;
+} shape_span_t;
+
+// Cached shape, keyed by the primitive and its parameters less the position
+typedef struct {
+	int32_t     _key[5];
+	int32_t     _first;   // first span in the pool, -1 for an empty slot
+	int32_t     _count;
+} shape_entry_t;
+
+// Span lists of recently drawn shapes in a fixed budget. When either the
+// shapes or the span pool are full the cache is cleared and refilled.
+typedef struct {
+	shape_entry_t *_table;  // open addressed, _size slots
+	int32_t     _size;
+	int32_t     _count;
+	int32_t     _max_shapes;
+	shape_span_t *_spans;   // pool of spans
+	int32_t     _max_spans;
+	int32_t     _used;
+	uint16_t   *_scratch;   // a missed shape is rasterized here
+	uint32_t    _hits;      // counters, never reset by the cache
+	uint32_t    _misses;
+	uint32_t    _clears;
+} shapecache_t;
+
+bool lcdShapeCacheCreate(shapecache_t *sc, int32_t max_shapes, int32_t max_spans);
+void lcdShapeCacheClear(shapecache_t *sc);
+void lcdShapeCacheDelete(shapecache_t *sc);
+
+// Cached versions of the lcd.h primitives, drawn at any position
+void lcdShapeFillTri(TFT_t *dev, shapecache_t *sc, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color);
+void lcdShapeDrawRectangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
+void lcdShapeDrawTriangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
+void lcdShapeDrawRegularPolygon(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color);
+void lcdShapeFillRectangle(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t w, int32_t h, int32_t angle, uint16_t color);
+void lcdShapeFillRegularPolygon(TFT_t *dev, shapecache_t *sc, int32_t xc, int32_t yc, int32_t n, int32_t r, int32_t angle, uint16_t color);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_SHAPE_H_
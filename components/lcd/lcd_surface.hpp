@@ -0,0 +1,142 @@
+#ifndef LCD_SURFACE_HPP_
+#define LCD_SURFACE_HPP_
+
+// Header-only C++ drawing on a pixel buffer whose size and pixel format
+// are template parameters. Strides and bounds are compile-time constants
+// and format conversions are resolved statically, so the kernels have no
+// loads of width/height and no mode branches. C code keeps using lcd.h.
+
+#include <stdint.h>
+#include <string.h> // memcpy
+#include <type_traits> // std::is_same
+#include "lcd.h"
+
+namespace lcd {
+
+// Pixel formats, conversions to and from native RGB565
+
+// Native RGB565, the frame buffer format
+struct Rgb565 {
+	static constexpr uint16_t from565(uint16_t c) { return c; }
+	static constexpr uint16_t to565(uint16_t p) { return p; }
+};
+
+// RGB565 in panel byte order, ready to send without a swap
+struct Rgb565Swapped {
+	static constexpr uint16_t from565(uint16_t c) { return (uint16_t)((c << 8) | (c >> 8)); }
+	static constexpr uint16_t to565(uint16_t p) { return (uint16_t)((p << 8) | (p >> 8)); }
+};
+
+template <int32_t W, int32_t H, class Format = Rgb565>
+class Surface {
+public:
+	static constexpr int32_t width = W;
+	static constexpr int32_t height = H;
+	static constexpr int32_t stride = W;
+	typedef Format format;
+
+	// pixels: W*H elements, row by row
+	explicit Surface(uint16_t *pixels) : _pixels(pixels) {}
+
+	// View of a device frame buffer. Not valid() if the device has none or
+	// its size does not match.
+	static Surface frame(TFT_t *dev) {
+		static_assert(std::is_same<Format, Rgb565>::value, "the frame buffer is native RGB565");
+		bool ok = dev->_use_frame_buffer && dev->_width == W && dev->_height == H;
+		return Surface(ok ? dev->_frame_buffer : nullptr);
+	}
+
+	bool valid() const { return _pixels != nullptr; }
+	uint16_t *data() const { return _pixels; }
+
+	// Plain C view for the lcd.h blit functions
+	surface_t c_surface() const {
+		static_assert(std::is_same<Format, Rgb565>::value, "lcd.h surfaces are native RGB565");
+		return surface_t{W, H, stride, _pixels};
+	}
+
+	void pixel(int32_t x, int32_t y, uint16_t color) {
+		if ((uint32_t)x >= (uint32_t)W || (uint32_t)y >= (uint32_t)H) return;
+		_pixels[y*stride + x] = Format::from565(color);
+	}
+
+	uint16_t pixel(int32_t x, int32_t y) const {
+		if ((uint32_t)x >= (uint32_t)W || (uint32_t)y >= (uint32_t)H) return 0;
+		return Format::to565(_pixels[y*stride + x]);
+	}
+
+	void fill(uint16_t color) {
+		const uint16_t p = Format::from565(color);
+		for (int32_t i = 0; i < W*H; i++) _pixels[i] = p;
+	}
+
+	void hline(int32_t x, int32_t y, int32_t w, uint16_t color) {
+		fillRect(x, y, x+w-1, y, color);
+	}
+
+	void vline(int32_t x, int32_t y, int32_t h, uint16_t color) {
+		fillRect(x, y, x, y+h-1, color);
+	}
+
+	// x1 <= x2 && y1 <= y2, inclusive like lcdFillRect
+	void fillRect(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color) {
+		if (x2 < 0 || x1 >= W || y2 < 0 || y1 >= H) return; // off screen
+		if (x1 < 0) x1 = 0; // clip
+		if (x2 >= W) x2 = W-1;
+		if (y1 < 0) y1 = 0;
+		if (y2 >= H) y2 = H-1;
+		const uint16_t p = Format::from565(color);
+		uint16_t *row = _pixels + y1*stride + x1;
+		const int32_t n = x2-x1+1;
+		for (int32_t j = y1; j <= y2; j++, row += stride) {
+			for (int32_t i = 0; i < n; i++) row[i] = p;
+		}
+	}
+
+	// Bresenham line, clipped per pixel
+	void line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, uint16_t color) {
+		const uint16_t p = Format::from565(color);
+		int32_t dx = (x2 > x1) ? x2-x1 : x1-x2, sx = (x2 > x1) ? 1 : -1;
+		int32_t dy = (y2 > y1) ? y1-y2 : y2-y1, sy = (y2 > y1) ? 1 : -1;
+		int32_t err = dx + dy;
+		for (;;) {
+			if ((uint32_t)x1 < (uint32_t)W && (uint32_t)y1 < (uint32_t)H) _pixels[y1*stride + x1] = p;
+			if (x1 == x2 && y1 == y2) break;
+			int32_t e2 = 2*err;
+			if (e2 >= dy) {err += dy; x1 += sx;}
+			if (e2 <= dx) {err += dx; y1 += sy;}
+		}
+	}
+
+	// Copy another surface to (x, y), converting the format per pixel only
+	// when the two formats differ
+	template <int32_t W2, int32_t H2, class F2>
+	void blit(int32_t x, int32_t y, const Surface<W2, H2, F2> &src) {
+		int32_t x1 = x, x2 = x+W2-1, y1 = y, y2 = y+H2-1;
+		if (x2 < 0 || x1 >= W || y2 < 0 || y1 >= H) return; // off screen
+		if (x1 < 0) x1 = 0; // clip
+		if (x2 >= W) x2 = W-1;
+		if (y1 < 0) y1 = 0;
+		if (y2 >= H) y2 = H-1;
+		const uint16_t *from = src.data() + (y1-y)*W2 + (x1-x);
+		uint16_t *to = _pixels + y1*stride + x1;
+		const int32_t n = x2-x1+1;
+		for (int32_t j = y1; j <= y2; j++, from += W2, to += stride) {
+			if constexpr (std::is_same<Format, F2>::value) {
+				memcpy(to, from, n*sizeof(uint16_t));
+			} else {
+				for (int32_t i = 0; i < n; i++) to[i] = Format::from565(F2::to565(from[i]));
+			}
+		}
+	}
+
+private:
+	uint16_t *_pixels;
+};
+
+// Surface the size of the display
+typedef Surface<LCD_W, LCD_H> Screen;
+
+} // namespace lcd
+
+#endif // LCD_SURFACE_HPP_
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <time.h> // time
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "lcd_surface.hpp"
+#include "lcd_test.h"
+
+// Same work as FillRectTest and LineTest, drawn with the C functions and
+// then through lcd::Screen so the times show the gain of compile-time
+// strides and bounds. Only the drawing is timed, in microseconds; the
+// frame is flushed afterwards.
+#define SURFACE_RECTS 99
+#define SURFACE_LINES 99
+
+TickType_t SurfaceTest(TFT_t *dev, int32_t width, int32_t height) {
+	lcd::Screen screen = lcd::Screen::frame(dev);
+	if (!screen.valid()) {
+		ESP_LOGW(__FUNCTION__, "needs a %dx%d frame buffer", LCD_W, LCD_H);
+		return 0;
+	}
+
+	// one workload for both passes
+	int16_t rects[SURFACE_RECTS][3];
+	int16_t lines[SURFACE_LINES][4];
+	uint16_t colors[SURFACE_RECTS+SURFACE_LINES];
+	srand( (unsigned int)time( NULL ) );
+	for(int32_t i=0;i<SURFACE_RECTS+SURFACE_LINES;i++) {
+		colors[i]=rgb565(rand()&0xFFU, rand()&0xFFU, rand()&0xFFU);
+	}
+	for(int32_t i=0;i<SURFACE_RECTS;i++) {
+		rects[i][0]=rand()%width;
+		rects[i][1]=rand()%height;
+		rects[i][2]=rand()%(width/5);
+	}
+	for(int32_t i=0;i<SURFACE_LINES;i++) {
+		lines[i][0]=rand()%width;
+		lines[i][1]=rand()%height;
+		lines[i][2]=rand()%width;
+		lines[i][3]=rand()%height;
+	}
+
+	int64_t t0 = esp_timer_get_time();
+	lcdFillScreen(dev, CYAN);
+	int64_t t1 = esp_timer_get_time();
+	for(int32_t i=0;i<SURFACE_RECTS;i++) {
+		const int16_t *r = rects[i];
+		lcdFillRect(dev, r[0], r[1], r[0]+r[2], r[1]+r[2], colors[i]);
+	}
+	int64_t t2 = esp_timer_get_time();
+	for(int32_t i=0;i<SURFACE_LINES;i++) {
+		const int16_t *l = lines[i];
+		lcdDrawLine(dev, l[0], l[1], l[2], l[3], colors[SURFACE_RECTS+i]);
+	}
+	int64_t t3 = esp_timer_get_time();
+	ESP_LOGI(__FUNCTION__, "C      fill:%" PRId64 " rects:%" PRId64 " lines:%" PRId64 " [us]", t1-t0, t2-t1, t3-t2);
+
+	t0 = esp_timer_get_time();
+	screen.fill(CYAN);
+	t1 = esp_timer_get_time();
+	for(int32_t i=0;i<SURFACE_RECTS;i++) {
+		const int16_t *r = rects[i];
+		screen.fillRect(r[0], r[1], r[0]+r[2], r[1]+r[2], colors[i]);
+	}
+	t2 = esp_timer_get_time();
+	for(int32_t i=0;i<SURFACE_LINES;i++) {
+		const int16_t *l = lines[i];
+		screen.line(l[0], l[1], l[2], l[3], colors[SURFACE_RECTS+i]);
+	}
+	t3 = esp_timer_get_time();
+	ESP_LOGI(__FUNCTION__, "Screen fill:%" PRId64 " rects:%" PRId64 " lines:%" PRId64 " [us]", t1-t0, t2-t1, t3-t2);
+
+	lcdWriteFrame(dev);
+	return pdMS_TO_TICKS((t3-t0)/1000);
+}
@@ -6,9 +6,15 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "lcd.h"
+#include "lcd_test.h"
+#include "lcd_qoi.h"
+#include "lcd_list.h"
+#include "lcd_shape.h"
 
 #define INTERVAL 200
 #define WAIT vTaskDelay(INTERVAL)
@@ -136,6 +142,83 @@ TickType_t ColorBandTest(TFT_t *dev, int32_t width, int32_t height) {
 	return diffTick;
 }
 
+TickType_t GradientTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	startTick = xTaskGetTickCount();
+
+	// checkerboard pattern for the frame
+	uint16_t pattern[64];
+	for(int32_t i=0;i<64;i++) {
+		pattern[i] = (((i >> 3) ^ i) & 4) ? WHITE : GRAY;
+	}
+	lcdFillPattern(dev, 0, 0, width-1, height-1, pattern);
+	lcdFillGradientH(dev, 8, 8, width-9, height/2-1, RED, BLUE);
+	lcdFillGradientV(dev, 8, height/2, width-9, height-9, GREEN, BLACK);
+	lcdWriteFrame(dev);
+
+	endTick = xTaskGetTickCount();
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+// Convert a generated RGB888 gradient with and without dither, and in
+// panel byte order, timing each conversion
+TickType_t ConvertTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	int32_t w = 96, h = 48;
+
+	uint8_t *rgb = heap_caps_malloc(w*h*3, MALLOC_CAP_8BIT);
+	uint16_t *pixels = heap_caps_malloc(sizeof(uint16_t)*w*h*2, MALLOC_CAP_8BIT);
+	if (rgb == NULL || pixels == NULL) {
+		ESP_LOGE(__FUNCTION__, "heap_caps_malloc fail");
+		if (rgb != NULL) heap_caps_free(rgb);
+		if (pixels != NULL) heap_caps_free(pixels);
+		return 0;
+	}
+	startTick = xTaskGetTickCount();
+
+	// smooth ramps, where truncation to RGB565 shows bands
+	for(int32_t j=0;j<h;j++) {
+		for(int32_t i=0;i<w;i++) {
+			uint8_t *p = rgb + (j*w+i)*3;
+			p[0] = i*255/(w-1);
+			p[1] = j*255/(h-1);
+			p[2] = 255 - i*255/(w-1);
+		}
+	}
+	lcdFillScreen(dev, BLACK);
+	uint16_t *swapped = pixels + w*h;
+
+	int64_t t0 = esp_timer_get_time();
+	lcdConvertRGB888(pixels, rgb, w, h, 8, 8, 0);
+	int64_t t1 = esp_timer_get_time();
+	lcdDrawBitmap(dev, 8, 8, w, h, pixels, w);
+
+	int64_t t2 = esp_timer_get_time();
+	lcdConvertRGB888(pixels, rgb, w, h, 8, h+16, RGB_DITHER);
+	int64_t t3 = esp_timer_get_time();
+	lcdDrawBitmap(dev, 8, h+16, w, h, pixels, w);
+
+	int64_t t4 = esp_timer_get_time();
+	lcdConvertRGB888(swapped, rgb, w, h, 8, h+16, RGB_DITHER | RGB_SWAPPED);
+	int64_t t5 = esp_timer_get_time();
+	int32_t bad = 0;
+	for(int32_t i=0;i<w*h;i++) {
+		if (swapped[i] != (uint16_t)(pixels[i] << 8 | pixels[i] >> 8)) bad++;
+	}
+	lcdWriteFrame(dev);
+
+	endTick = xTaskGetTickCount();
+	heap_caps_free(rgb);
+	heap_caps_free(pixels);
+	ESP_LOGI(__FUNCTION__, "%"PRId32"x%"PRId32" truncate:%"PRId64" dither:%"PRId64" swapped:%"PRId64" [us] mismatch:%"PRId32,
+		w, h, t1-t0, t3-t2, t5-t4, bad);
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
 TickType_t FillRectTest(TFT_t *dev, int32_t width, int32_t height) {
 	TickType_t startTick, endTick, diffTick;
 	startTick = xTaskGetTickCount();
@@ -393,6 +476,206 @@ TickType_t TriangleTest(TFT_t *dev, int32_t width, int32_t height) {
 	return diffTick;
 }
 
+TickType_t FillPolygonTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	startTick = xTaskGetTickCount();
+
+	uint16_t color;
+	lcdFillScreen(dev, CYAN);
+
+	uint16_t red;
+	uint16_t green;
+	uint16_t blue;
+	srand( (unsigned int)time( NULL ) );
+	for(int32_t i=1;i<100;i++) {
+		red=rand()&0xFFU;
+		green=rand()&0xFFU;
+		blue=rand()&0xFFU;
+		color=rgb565(red, green, blue);
+		int32_t xpos=rand()%width;
+		int32_t ypos=rand()%height;
+		int32_t size=rand()%(width/5)+1;
+		int32_t angle=rand()%360;
+		if (i & 1)
+			lcdFillRegularPolygon(dev, xpos, ypos, (i%6)+3, size, angle, color);
+		else
+			lcdFillRectangle(dev, xpos, ypos, size, size/2, angle, color);
+	}
+	lcdWriteFrame(dev);
+
+	endTick = xTaskGetTickCount();
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+// Cover the screen with copies of a 64x64 image, clipped at the edges
+TickType_t BitmapTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+
+	uint16_t *image = heap_caps_malloc(64*64*sizeof(uint16_t), MALLOC_CAP_8BIT);
+	if (image == NULL) {
+		ESP_LOGE(__FUNCTION__, "heap_caps_malloc fail");
+		return 0;
+	}
+	for(int32_t j=0;j<64;j++) {
+		for(int32_t i=0;i<64;i++) {
+			image[j*64+i] = rgb565(i*4, j*4, (i^j)*4);
+		}
+	}
+
+	startTick = xTaskGetTickCount();
+	for(int32_t y=-16;y<height;y+=64) {
+		for(int32_t x=-16;x<width;x+=64) {
+			lcdDrawBitmap(dev, x, y, 64, 64, image, 64);
+		}
+	}
+	lcdWriteFrame(dev);
+	endTick = xTaskGetTickCount();
+	heap_caps_free(image);
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+// A static screen with one changing line of text, refreshed through a
+// partial display area, then idle mode
+TickType_t PartialTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+
+	lcdFillScreen(dev, BLACK);
+	lcdSetFontSize(dev, 2);
+	lcdSetFontBackground(dev, BLACK);
+	lcdDrawString(dev, 10, 10, "PAUSED", YELLOW);
+	lcdWriteFrame(dev);
+
+	int32_t y = height/2;
+	char text[16];
+	lcdPartialOn(dev, y, y+LCD_CHAR_H*2-1);
+	startTick = xTaskGetTickCount();
+	for(int32_t i=0;i<100;i++) {
+		sprintf(text, "frame %3"PRId32, i);
+		lcdDrawString(dev, 10, y, text, WHITE);
+		lcdWriteFrame(dev); // only the partial rows
+	}
+	endTick = xTaskGetTickCount();
+
+	lcdIdleOn(dev);
+	vTaskDelay(INTERVAL);
+	lcdIdleOff(dev);
+	lcdPartialOff(dev);
+	lcdNoFontBackground(dev);
+	lcdSetFontSize(dev, 1);
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+// Minimal QOI encoder (RGB, INDEX, DIFF and RUN ops) for QoiTest
+// Return the image size, or 0 if it does not fit in max bytes.
+static size_t qoi_encode(const uint16_t *pixels, int32_t width, int32_t height, uint8_t *out, size_t max) {
+	uint8_t index[64][4] = {{0}};
+	uint8_t prev[4] = {0, 0, 0, 255};
+	size_t pos = 0;
+	int32_t run = 0;
+	memcpy(out, "qoif", 4);
+	for(int32_t i=0;i<4;i++) {
+		out[4+i] = width >> (24-8*i);
+		out[8+i] = height >> (24-8*i);
+	}
+	out[12] = 3; // RGB
+	out[13] = 0; // sRGB
+	pos = 14;
+	for(int32_t i=0;i<width*height;i++) {
+		if (pos+5+8 > max) return 0; // largest op and the end marker
+		uint16_t c = pixels[i];
+		uint8_t px[4] = {(c >> 8) & 0xF8, (c >> 3) & 0xFC, (c << 3) & 0xF8, 255};
+		if (memcmp(px, prev, 4) == 0) {
+			if (++run == 62 || i == width*height-1) {out[pos++] = 0xC0 | (run-1); run = 0;}
+			continue;
+		}
+		if (run) {out[pos++] = 0xC0 | (run-1); run = 0;}
+		int32_t h = (px[0]*3 + px[1]*5 + px[2]*7 + px[3]*11) & 63;
+		int32_t dr = (int8_t)(px[0]-prev[0]), dg = (int8_t)(px[1]-prev[1]), db = (int8_t)(px[2]-prev[2]);
+		if (memcmp(index[h], px, 4) == 0) {
+			out[pos++] = h;
+		} else if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+			out[pos++] = 0x40 | (dr+2) << 4 | (dg+2) << 2 | (db+2);
+		} else {
+			out[pos++] = 0xFE;
+			memcpy(&out[pos], px, 3);
+			pos += 3;
+		}
+		memcpy(index[h], px, 4);
+		memcpy(prev, px, 4);
+	}
+	memset(&out[pos], 0, 7);
+	out[pos+7] = 1;
+	return pos+8;
+}
+
+// Decode an image of the current screen several times and compare with
+// the time to flush the same number of frames. A whole screen may not fit
+// in the heap next to the frame buffer, so the top band of rows that
+// encodes into the buffer is used and tiled down the screen.
+TickType_t QoiTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+
+	size_t max = 32*1024;
+	uint8_t *qoi = heap_caps_malloc(max, MALLOC_CAP_8BIT);
+	if (qoi == NULL) {
+		ESP_LOGE(__FUNCTION__, "heap_caps_malloc fail");
+		return 0;
+	}
+	int32_t rows = height;
+	size_t size;
+	while ((size = qoi_encode(dev->_frame_buffer, width, rows, qoi, max)) == 0 && rows > 1) rows /= 2;
+	if (size == 0) {
+		heap_caps_free(qoi);
+		return 0;
+	}
+	ESP_LOGI(__FUNCTION__, "image %"PRId32" rows %"PRIu32" bytes", rows, (uint32_t)size);
+
+	startTick = xTaskGetTickCount();
+	for(int32_t i=0;i<10;i++) {
+		lcdWriteFrame(dev);
+	}
+	endTick = xTaskGetTickCount();
+	ESP_LOGI(__FUNCTION__, "flush x10 elapsed time[ms]:%"PRIu32,(endTick - startTick)*portTICK_PERIOD_MS);
+
+	startTick = xTaskGetTickCount();
+	for(int32_t i=0;i<10;i++) {
+		for(int32_t y=0;y<height;y+=rows) {
+			lcdDrawQoi(dev, 0, y, qoi, size);
+		}
+	}
+	lcdWriteFrame(dev);
+	endTick = xTaskGetTickCount();
+	heap_caps_free(qoi);
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "decode x10 elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+TickType_t FadeTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	startTick = xTaskGetTickCount();
+
+	// Fade the current frame to black, one full screen blend per step
+	for(int32_t i=0;i<16;i++) {
+		lcdFillRectAlpha(dev, 0, 0, width-1, height-1, BLACK, 4);
+		lcdWriteFrame(dev);
+	}
+
+	endTick = xTaskGetTickCount();
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
 TickType_t TextDirTest(TFT_t *dev, int32_t width, int32_t height) {
 	TickType_t startTick, endTick, diffTick;
 	startTick = xTaskGetTickCount();
@@ -411,7 +694,6 @@ TickType_t TextDirTest(TFT_t *dev, int32_t width, int32_t height) {
 	lcdSetFontDirection(dev, 0);
 	lcdDrawString(dev, 0, 0, ascii, color);
 
-#if 0 // other directions unimplemented
 	color = BLUE;
 	strcpy(ascii, "Direction=2");
 	lcdSetFontDirection(dev, 2);
@@ -426,7 +708,7 @@ TickType_t TextDirTest(TFT_t *dev, int32_t width, int32_t height) {
 	strcpy(ascii, "Direction=3");
 	lcdSetFontDirection(dev, 3);
 	lcdDrawString(dev, 0, height-1, ascii, color);
-#endif
+	lcdSetFontDirection(dev, 0);
 	lcdWriteFrame(dev);
 
 	endTick = xTaskGetTickCount();
@@ -500,11 +782,118 @@ TickType_t TextTest(TFT_t *dev, int32_t width, int32_t height) {
 	return diffTick;
 }
 
+// The FillTriTest and TextTest scenes recorded in a display list and drawn
+// by one worker per core
+TickType_t ListTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	displaylist_t list;
+
+	if (!lcdListCreate(dev, &list, 256, 1024)) return 0;
+	startTick = xTaskGetTickCount();
+
+	uint16_t color;
+	lcdListFillScreen(&list, CYAN);
+	srand( (unsigned int)time( NULL ) );
+	for(int32_t i=1;i<100;i++) {
+		color=rgb565(rand()&0xFFU, rand()&0xFFU, rand()&0xFFU);
+		int32_t x0=rand()%width;
+		int32_t y0=rand()%height;
+		int32_t x1=rand()%width;
+		int32_t y1=rand()%height;
+		int32_t x2=rand()%width;
+		int32_t y2=rand()%height;
+		lcdListFillTri(&list, x0, y0, x1, y1, x2, y2, color);
+	}
+
+	uint8_t size;
+	char text[] = "Carpe Diem!";
+	uint32_t tlen = strlen(text);
+	uint16_t bgtab[] = {RED,GREEN,BLUE,BLACK,GRAY,YELLOW,CYAN,PURPLE};
+	for(int32_t i=1;i<100;i++) {
+		color=rgb565(rand()&0xFFU, rand()&0xFFU, rand()&0xFFU);
+		size = (i&0x3)+1;
+		int32_t xpos=rand()%(width-LCD_CHAR_W*size*tlen+1);
+		int32_t ypos=rand()%(height-LCD_CHAR_H*size+1);
+		lcdSetFontSize(dev, size);
+		lcdSetFontBackground(dev, bgtab[i%8]);
+		lcdListDrawString(&list, xpos, ypos, text, color);
+	}
+	lcdListFlush(&list);
+
+	endTick = xTaskGetTickCount();
+	lcdListDelete(&list);
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+TickType_t CullTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	displaylist_t list;
+
+	if (!lcdListCreate(dev, &list, 256, 1024)) return 0;
+	lcdListCullEnable(&list);
+	startTick = xTaskGetTickCount();
+
+	// a frame of small objects, mostly hidden by a few opaque panels
+	uint16_t color;
+	lcdListFillScreen(&list, BLACK);
+	srand( (unsigned int)time( NULL ) );
+	for(int32_t i=1;i<200;i++) {
+		color=rgb565(rand()&0xFFU, rand()&0xFFU, rand()&0xFFU);
+		int32_t xpos=rand()%width;
+		int32_t ypos=rand()%height;
+		lcdListFillCircle(&list, xpos, ypos, 8, color);
+	}
+	lcdListFillRect(&list, 0, 0, width/2-1, height-1, GRAY);
+	lcdListFillRect(&list, width/2, height/3, width-1, height-1, BLUE);
+	lcdListDrawString(&list, 10, 10, "Culled", WHITE);
+	lcdListFlush(&list);
+
+	endTick = xTaskGetTickCount();
+	ESP_LOGI(__FUNCTION__, "culled:%"PRId32" saved pixels:%"PRId32, list._culled, list._saved);
+	lcdListDelete(&list);
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
+TickType_t ShapeTest(TFT_t *dev, int32_t width, int32_t height) {
+	TickType_t startTick, endTick, diffTick;
+	shapecache_t cache;
+
+	if (!lcdShapeCacheCreate(&cache, 32, 2048)) return 0;
+	startTick = xTaskGetTickCount();
+
+	// a few ship and icon shapes, redrawn all over the screen
+	lcdFillScreen(dev, BLACK);
+	srand( (unsigned int)time( NULL ) );
+	for(int32_t i=1;i<1000;i++) {
+		int32_t xpos=rand()%width;
+		int32_t ypos=rand()%height;
+		int32_t angle=(i%8)*45;
+		switch (i%3) {
+		case 0: lcdShapeFillRectangle(dev, &cache, xpos, ypos, 24, 12, angle, YELLOW); break;
+		case 1: lcdShapeFillTri(dev, &cache, xpos, ypos, xpos-8, ypos+20, xpos+8, ypos+20, RED); break;
+		case 2: lcdShapeDrawRegularPolygon(dev, &cache, xpos, ypos, 6, 10, angle, CYAN); break;
+		}
+	}
+	if (dev->_use_frame_buffer) lcdWriteFrame(dev);
+
+	endTick = xTaskGetTickCount();
+	ESP_LOGI(__FUNCTION__, "hits:%"PRIu32" misses:%"PRIu32" clears:%"PRIu32, cache._hits, cache._misses, cache._clears);
+	lcdShapeCacheDelete(&cache);
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "elapsed time[ms]:%"PRIu32,diffTick*portTICK_PERIOD_MS);
+	return diffTick;
+}
+
 void LCD(void *pvParameters)
 {
 	TFT_t dev;
 
 	lcdInit(&dev);
+	if (pvParameters != NULL) lcdSetFont(&dev, pvParameters);
 
 	while(1) {
 
@@ -517,6 +906,12 @@ void LCD(void *pvParameters)
 		ColorBandTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
+		GradientTest(&dev, LCD_W, LCD_H);
+		WAIT;
+
+		ConvertTest(&dev, LCD_W, LCD_H);
+		WAIT;
+
 		ArrowTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
@@ -535,13 +930,38 @@ void LCD(void *pvParameters)
 		FillRectTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
+		if (dev._use_frame_buffer == true) {
+			SurfaceTest(&dev, LCD_W, LCD_H);
+			WAIT;
+		}
+
 		FillTriTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
 		FillCircleTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
+		FillPolygonTest(&dev, LCD_W, LCD_H);
+		WAIT;
+
+		ShapeTest(&dev, LCD_W, LCD_H);
+		WAIT;
+
+		if (dev._use_frame_buffer == true) {
+			QoiTest(&dev, LCD_W, LCD_H);
+			WAIT;
+
+			FadeTest(&dev, LCD_W, LCD_H);
+			WAIT;
+
+			PartialTest(&dev, LCD_W, LCD_H);
+			WAIT;
+		}
+
 		if (dev._use_frame_buffer == false) {
+			BitmapTest(&dev, LCD_W, LCD_H);
+			WAIT;
+
 			RectangleTest(&dev, LCD_W, LCD_H);
 			WAIT;
 
@@ -558,5 +978,13 @@ void LCD(void *pvParameters)
 		TextTest(&dev, LCD_W, LCD_H);
 		WAIT;
 
+		if (dev._use_frame_buffer == true) {
+			ListTest(&dev, LCD_W, LCD_H);
+			WAIT;
+
+			CullTest(&dev, LCD_W, LCD_H);
+			WAIT;
+		}
+
 	} // end while
 }
@@ -5,6 +5,10 @@
 #include "freertos/FreeRTOS.h" // TickType_t
 #include "lcd.h" // TFT_t
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 TickType_t LineTestHV(TFT_t *dev, int32_t width, int32_t height);
 
 TickType_t LineTest(TFT_t *dev, int32_t width, int32_t height);
@@ -15,8 +19,14 @@ TickType_t ColorBarTest(TFT_t *dev, int32_t width, int32_t height);
 
 TickType_t ColorBandTest(TFT_t *dev, int32_t width, int32_t height);
 
+TickType_t GradientTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t ConvertTest(TFT_t *dev, int32_t width, int32_t height);
+
 TickType_t FillRectTest(TFT_t *dev, int32_t width, int32_t height);
 
+TickType_t SurfaceTest(TFT_t *dev, int32_t width, int32_t height); // lcd_surface_test.cpp
+
 TickType_t FillTriTest(TFT_t *dev, int32_t width, int32_t height);
 
 TickType_t FillCircleTest(TFT_t *dev, int32_t width, int32_t height);
@@ -31,11 +41,34 @@ TickType_t RectangleTest(TFT_t *dev, int32_t width, int32_t height);
 
 TickType_t TriangleTest(TFT_t *dev, int32_t width, int32_t height);
 
+TickType_t FillPolygonTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t ShapeTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t BitmapTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t QoiTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t FadeTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t PartialTest(TFT_t *dev, int32_t width, int32_t height);
+
 TickType_t TextDirTest(TFT_t *dev, int32_t width, int32_t height);
 
 TickType_t TextParamTest(TFT_t *dev, int32_t width, int32_t height);
 
+TickType_t TextTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t ListTest(TFT_t *dev, int32_t width, int32_t height);
+
+TickType_t CullTest(TFT_t *dev, int32_t width, int32_t height);
+
 // Calls all the tests in a forever loop
+// pvParameters: font glyphs for lcdSetFont(), or NULL for the default
 void LCD(void *pvParameters);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // LCD_TEST_H_
@@ -0,0 +1,111 @@
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "lcd_tilemap.h"
+
+#define TAG "lcd_tilemap"
+
+// Create a tilemap with every cell empty (TILE_NONE)
+// x:X coordinate of the top left cell
+// y:Y coordinate of the top left cell
+// cols:number of cells per row
+// rows:number of rows
+// tile_w:tile width in pixels
+// tile_h:tile height in pixels
+// tiles:tileset, count tiles of tile_w*tile_h pixels each
+// count:number of tiles in tileset
+bool lcdTilemapCreate(tilemap_t *tm, int32_t x, int32_t y, int32_t cols, int32_t rows,
+	int32_t tile_w, int32_t tile_h, const uint16_t *tiles, uint16_t count)
+{
+	size_t size = sizeof(uint16_t)*cols*rows;
+	tm->_map = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+	tm->_drawn = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+	if (tm->_map == NULL || tm->_drawn == NULL) {
+		ESP_LOGE(TAG, "heap_caps_malloc fail");
+		lcdTilemapDelete(tm);
+		return false;
+	}
+	tm->_x = x;
+	tm->_y = y;
+	tm->_cols = cols;
+	tm->_rows = rows;
+	tm->_tile_w = tile_w;
+	tm->_tile_h = tile_h;
+	tm->_tiles = tiles;
+	tm->_count = count;
+	for (int32_t i = 0; i < cols*rows; i++) tm->_map[i] = tm->_drawn[i] = TILE_NONE;
+	tm->_changed = false;
+	return true;
+}
+
+// Set the tile of one cell, drawn by the next lcdTilemapDraw
+void lcdTilemapSet(tilemap_t *tm, int32_t col, int32_t row, uint16_t tile)
+{
+	if (col < 0 || col >= tm->_cols || row < 0 || row >= tm->_rows) return;
+	if (tile >= tm->_count) tile = TILE_NONE;
+	uint16_t *cell = &tm->_map[row*tm->_cols+col];
+	if (*cell == tile) return;
+	*cell = tile;
+	tm->_changed = true;
+}
+
+uint16_t lcdTilemapGet(const tilemap_t *tm, int32_t col, int32_t row)
+{
+	if (col < 0 || col >= tm->_cols || row < 0 || row >= tm->_rows) return TILE_NONE;
+	return tm->_map[row*tm->_cols+col];
+}
+
+// Set the tile of every cell
+void lcdTilemapFill(tilemap_t *tm, uint16_t tile)
+{
+	for (int32_t row = 0; row < tm->_rows; row++) {
+		for (int32_t col = 0; col < tm->_cols; col++) {
+			lcdTilemapSet(tm, col, row, tile);
+		}
+	}
+}
+
+// Redraw every cell on the next lcdTilemapDraw, e.g. after the screen
+// under the map was cleared
+void lcdTilemapInvalidate(tilemap_t *tm)
+{
+	for (int32_t i = 0; i < tm->_cols*tm->_rows; i++) tm->_drawn[i] = TILE_NONE;
+	tm->_changed = true;
+}
+
+// Copy one tile to the screen, one window per tile in direct mode
+static void tile_draw(TFT_t *dev, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *pixels)
+{
+	lcdDrawBitmap(dev, x, y, w, h, pixels, w);
+	if (dev->_use_frame_buffer) lcdDirtyAdd(dev, x, y, x+w-1, y+h-1);
+}
+
+// Draw the cells whose tile changed since they were last drawn.
+// In frame buffer mode each drawn tile is added to the dirty regions,
+// send them with lcdWriteDirty. Empty cells are left as they are.
+void lcdTilemapDraw(TFT_t *dev, tilemap_t *tm)
+{
+	if (!tm->_changed) return;
+
+	int32_t tile_size = tm->_tile_w*tm->_tile_h;
+	for (int32_t row = 0, i = 0; row < tm->_rows; row++) {
+		int32_t y = tm->_y + row*tm->_tile_h;
+		for (int32_t col = 0; col < tm->_cols; col++, i++) {
+			uint16_t tile = tm->_map[i];
+			if (tile == tm->_drawn[i]) continue;
+			tm->_drawn[i] = tile;
+			if (tile == TILE_NONE) continue;
+			tile_draw(dev, tm->_x + col*tm->_tile_w, y, tm->_tile_w, tm->_tile_h,
+				tm->_tiles + tile*tile_size);
+		}
+	}
+	tm->_changed = false;
+}
+
+void lcdTilemapDelete(tilemap_t *tm)
+{
+	if (tm->_map != NULL) heap_caps_free(tm->_map);
+	if (tm->_drawn != NULL) heap_caps_free(tm->_drawn);
+	tm->_map = NULL;
+	tm->_drawn = NULL;
+}
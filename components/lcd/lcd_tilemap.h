@@ -0,0 +1,42 @@
+#ifndef LCD_TILEMAP_H_
+#define LCD_TILEMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Map cell that holds no tile (not drawn)
+#define TILE_NONE 0xFFFF
+
+typedef struct {
+	int32_t     _x;         // screen position of the top left cell
+	int32_t     _y;
+	int32_t     _cols;
+	int32_t     _rows;
+	int32_t     _tile_w;    // tile size in pixels, typically 8 or 16
+	int32_t     _tile_h;
+	const uint16_t *_tiles; // tileset, _tile_w*_tile_h RGB565 pixels per tile
+	uint16_t    _count;     // number of tiles in tileset
+	uint16_t   *_map;       // _cols*_rows tile indices, row by row
+	uint16_t   *_drawn;     // tile index last drawn in each cell
+	bool        _changed;   // any cell differs from _drawn
+} tilemap_t;
+
+bool lcdTilemapCreate(tilemap_t *tm, int32_t x, int32_t y, int32_t cols, int32_t rows,
+	int32_t tile_w, int32_t tile_h, const uint16_t *tiles, uint16_t count);
+void lcdTilemapSet(tilemap_t *tm, int32_t col, int32_t row, uint16_t tile);
+uint16_t lcdTilemapGet(const tilemap_t *tm, int32_t col, int32_t row);
+void lcdTilemapFill(tilemap_t *tm, uint16_t tile);
+void lcdTilemapInvalidate(tilemap_t *tm);
+void lcdTilemapDraw(TFT_t *dev, tilemap_t *tm);
+void lcdTilemapDelete(tilemap_t *tm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LCD_TILEMAP_H_
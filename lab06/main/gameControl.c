@@ -1,4 +1,3 @@
-
 #include <stdio.h>
 #include <stdlib.h> // rand
 
@@ -15,14 +14,23 @@
 #define Y_MARGIN 10
 #define X_MARGIN_SHOTS 20
 #define X_MARGIN_IMPACTED 200
+#define STATS_LEN 16 // Maximum characters in a stats label
 
+static label_t shots_label;
+static label_t impacted_label;
+static uint32_t shots;
+static uint32_t impacted;
 
 
 // Initialize the game control logic.
 // This function initializes all missiles, planes, stats, etc.
 void gameControl_init(void)
 {
-	
+	shots = 0;
+	impacted = 0;
+	lcdSetFontSize(&dev, 1);
+	lcdLabelCreate(&dev, &shots_label, X_MARGIN_SHOTS, Y_MARGIN, STATS_LEN);
+	lcdLabelCreate(&dev, &impacted_label, X_MARGIN_IMPACTED, Y_MARGIN, STATS_LEN);
 }
 
 // Update the game control logic.
@@ -31,5 +39,13 @@ void gameControl_init(void)
 // detects collisions, and updates statistics.
 void gameControl_tick(void)
 {
-	
+	char str[STATS_LEN+1];
+
+	// Labels only re-rasterize when a count changes
+	snprintf(str, sizeof(str), "Shot: %lu", (unsigned long)shots);
+	lcdLabelSet(&shots_label, str, CONFIG_COLOR_STATUS, CONFIG_COLOR_BACKGROUND);
+	lcdLabelDraw(&dev, &shots_label);
+	snprintf(str, sizeof(str), "Impacted: %lu", (unsigned long)impacted);
+	lcdLabelSet(&impacted_label, str, CONFIG_COLOR_STATUS, CONFIG_COLOR_BACKGROUND);
+	lcdLabelDraw(&dev, &impacted_label);
 }
@@ -8,6 +8,7 @@
 #include "config.h"
 #include "joy.h"
 #include "lcd.h"
+#include "lcd_saveunder.h"
 #include "cursor.h"
 #include "pin.h"
 #include "btn.h"
@@ -19,10 +20,14 @@
 #define TIME_OUT 500 // ms
 
 #define CURSOR_SZ 7 // Cursor size (width & height) in pixels
+#define SAVE_UNDER_SZ (CURSOR_SZ*CURSOR_SZ) // Pixels under moving objects
 
 static const char *TAG = "lab06";
 
 TFT_t dev; // Declare device handle for the display
+#ifdef CONFIG_ERASE
+saveunder_t under; // Scene under moving objects, restored each tick
+#endif // CONFIG_ERASE
 TimerHandle_t update_timer; // Declare timer handle for update callback
 
 volatile bool interrupt_flag;
@@ -56,6 +61,10 @@ void app_main(void)
 	lcdInit(&dev);
 	lcdFrameEnable(&dev);
 	lcdFillScreen(&dev, CONFIG_COLOR_BACKGROUND);
+#ifdef CONFIG_ERASE
+	lcdWriteFrame(&dev);
+	if (!lcdSaveUnderCreate(&under, SAVE_UNDER_SZ)) return;
+#endif // CONFIG_ERASE
 	cursor_init(PER_MS);
 	gameControl_init();
 
@@ -100,21 +109,25 @@ void app_main(void)
 		interrupt_flag = false;
 		isr_handled_count++;
 
-#ifndef CONFIG_ERASE
+#ifdef CONFIG_ERASE
+		// Erase only what was drawn over the scene last tick
+		lcdSaveUnderRestore(&dev, &under);
+#else
 		lcdFillScreen(&dev, CONFIG_COLOR_BACKGROUND);
 #endif // CONFIG_ERASE
 		gameControl_tick();
 		cursor_tick();
 		cursor_get_pos(&x, &y);
-#if 0
-		static int32_t lx = -1, ly = -1;
-		if (x != lx || y != ly) {
-			cursor(lx,  ly, CONFIG_COLOR_BACKGROUND);
-			lx = x; ly = y;
-		}
+#ifdef CONFIG_ERASE
+		int32_t s2 = CURSOR_SZ >> 1;
+		lcdSaveUnder(&dev, &under, x-s2, y-s2, x+s2, y+s2);
 #endif // CONFIG_ERASE
 		cursor(x, y, CONFIG_COLOR_CURSOR);
+#ifdef CONFIG_ERASE
+		lcdWriteDirty(&dev);
+#else
 		lcdWriteFrame(&dev);
+#endif // CONFIG_ERASE
 		t2 = esp_timer_get_time() - t1;
 		if (t2 > tmax) tmax = t2;
 	}
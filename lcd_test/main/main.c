@@ -1,10 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 
+#include "asset.h"
 #include "lcd.h"
 #include "lcd_test.h"
 
@@ -14,5 +16,20 @@ void app_main(void)
 {
 	ESP_LOGI(TAG, "Start up");
 
-	xTaskCreate(LCD, "LCD", 1024*6, NULL, 2, NULL);
+	// the font is read from the bundle in place, it is not in the app image
+	const uint8_t *font = NULL;
+	if (asset_init("storage") == 0) {
+		asset_t asset;
+		for (int32_t i = 0; i < asset_count(); i++) {
+			asset_get(i, &asset);
+			ESP_LOGI(TAG, "asset %s: type %d, %"PRIu32" bytes", asset_name(i), asset.type, asset.size);
+		}
+		if (asset_get(asset_find("font5x8"), &asset) && asset.type == ASSET_FONT &&
+			asset.info[0] == LCD_CHAR_W-1 && asset.info[1] == LCD_CHAR_H) {
+			font = asset.data;
+		}
+	}
+	if (font == NULL) ESP_LOGW(TAG, "no font5x8 asset, text is not drawn");
+
+	xTaskCreate(LCD, "LCD", 1024*6, (void *)font, 2, NULL);
 }